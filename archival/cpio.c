@@ -206,6 +206,7 @@ static NOINLINE int cpio_o(void)
 	};
 
 	struct inodes_s *links = NULL;
+	ino_dev_table_t *links_table = NULL;
 	off_t bytes = 0; /* output bytes count */
 
 	while (1) {
@@ -248,23 +249,18 @@ static NOINLINE int cpio_o(void)
 			if (!S_ISDIR(st.st_mode) && st.st_nlink > 1) {
 				struct name_s *n;
 				struct inodes_s *l;
+				void **found;
 
 				/* Do we have this hardlink remembered? */
-				l = links;
-				while (1) {
-					if (l == NULL) {
-						/* Not found: add new item to "links" list */
-						l = xzalloc(sizeof(*l));
-						l->st = st;
-						l->next = links;
-						links = l;
-						break;
-					}
-					if (l->st.st_ino == st.st_ino) {
-						/* found */
-						break;
-					}
-					l = l->next;
+				found = ino_dev_table_add(&links_table, &st);
+				l = *found;
+				if (l == NULL) {
+					/* Not found: add new item to "links" list */
+					l = xzalloc(sizeof(*l));
+					l->st = st;
+					l->next = links;
+					links = l;
+					*found = l;
 				}
 				/* Add new name to "l->names" list */
 				n = xmalloc(sizeof(*n) + strlen(name));
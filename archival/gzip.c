@@ -72,12 +72,23 @@ aa:      85.1% -- replaced with aa.gz
 //config:	  is 6. If levels 1-3 are specified, 4 is used.
 //config:	  If this option is not selected, -N options are ignored and -9
 //config:	  is used.
+//config:
+//config:config FEATURE_GZIP_PARALLEL
+//config:	bool "Enable parallel compression (-p N)"
+//config:	default y
+//config:	depends on GZIP && !NOMMU && PLATFORM_POSIX
+//config:	help
+//config:	  Enable -p N option which compresses with N worker processes,
+//config:	  like pigz does. Input is cut into 128k blocks, each block
+//config:	  is deflated separately (with the preceding 32k of input
+//config:	  as dictionary) and the results are joined with sync flushes
+//config:	  into a single gzip member.
 
 //applet:IF_GZIP(APPLET(gzip, BB_DIR_BIN, BB_SUID_DROP))
 //kbuild:lib-$(CONFIG_GZIP) += gzip.o
 
 //usage:#define gzip_trivial_usage
-//usage:       "[-cf" IF_GUNZIP("d") IF_FEATURE_GZIP_LEVELS("123456789") "] [FILE]..."
+//usage:       "[-cf" IF_GUNZIP("d") IF_FEATURE_GZIP_LEVELS("123456789") "]" IF_FEATURE_GZIP_PARALLEL(" [-p N]") " [FILE]..."
 //usage:#define gzip_full_usage "\n\n"
 //usage:       "Compress FILEs (or stdin)\n"
 //usage:	IF_FEATURE_GZIP_LEVELS(
@@ -88,6 +99,9 @@ aa:      85.1% -- replaced with aa.gz
 //usage:	)
 //usage:     "\n	-c	Write to stdout"
 //usage:     "\n	-f	Force"
+//usage:	IF_FEATURE_GZIP_PARALLEL(
+//usage:     "\n	-p N	Compress using N processes"
+//usage:	)
 //usage:
 //usage:#define gzip_example_usage
 //usage:       "$ ls -la /tmp/busybox*\n"
@@ -421,6 +435,18 @@ struct globals {
 
 	/*uint32_t *crc_32_tab;*/
 	uint32_t crc;	/* shift register contents */
+
+#if ENABLE_FEATURE_GZIP_PARALLEL
+	unsigned par_jobs;	/* -p N: number of worker processes */
+	smallint par_worker;	/* we are a worker: in/out are memory buffers */
+	smallint par_more;	/* more blocks follow ours: end with sync flush */
+	unsigned par_dictlen;	/* preset dictionary, tail of previous block */
+	const uch *par_dict;
+	const uch *par_in;	/* our block of input */
+	unsigned par_inlen;
+	uch *par_out;		/* collected compressed output */
+	unsigned par_outlen;
+#endif
 };
 
 #define G1 (*(ptr_to_globals - 1))
@@ -435,6 +461,17 @@ static void flush_outbuf(void)
 	if (G1.outcnt == 0)
 		return;
 
+#if ENABLE_FEATURE_GZIP_PARALLEL
+	if (G1.par_worker) {
+		/* Written to the pipe in one go when the block is done,
+		 * so that we don't stall while parent drains other workers */
+		G1.par_out = xrealloc(G1.par_out, G1.par_outlen + G1.outcnt);
+		memcpy(G1.par_out + G1.par_outlen, G1.outbuf, G1.outcnt);
+		G1.par_outlen += G1.outcnt;
+		G1.outcnt = 0;
+		return;
+	}
+#endif
 	xwrite(ofd, (char *) G1.outbuf, G1.outcnt);
 	G1.outcnt = 0;
 }
@@ -516,6 +553,16 @@ static unsigned file_read(void *buf, unsigned size)
 
 	Assert(G1.insize == 0, "l_buf not empty");
 
+#if ENABLE_FEATURE_GZIP_PARALLEL
+	if (G1.par_worker) {
+		/* crc and isize are accounted for by the parent */
+		len = MIN(size, G1.par_inlen);
+		memcpy(buf, G1.par_in, len);
+		G1.par_in += len;
+		G1.par_inlen -= len;
+		return len;
+	}
+#endif
 	len = safe_read(ifd, buf, size);
 	if (len == (unsigned)(-1) || len == 0)
 		return len;
@@ -1904,6 +1951,17 @@ static ulg deflate(void)
 	if (match_available)
 		ct_tally(0, G1.window[G1.strstart - 1]);
 
+#if ENABLE_FEATURE_GZIP_PARALLEL
+	if (G1.par_more) {
+		/* Not the last block of the member: finish with an empty
+		 * stored block, which leaves the output byte-aligned
+		 * so that the next worker's output can be appended to it */
+		FLUSH_BLOCK(0);
+		send_bits(STORED_BLOCK << 1, 3);
+		copy_block(NULL, 0, 1);
+		return G2.compressed_len >> 3;
+	}
+#endif
 	return FLUSH_BLOCK(1);	/* eof */
 }
 
@@ -1938,9 +1996,17 @@ static void lm_init(ush * flagsp)
 
 	G1.strstart = 0;
 	G1.block_start = 0L;
+#if ENABLE_FEATURE_GZIP_PARALLEL
+	/* Preset dictionary goes before the data, it is not emitted */
+	if (G1.par_dictlen) {
+		memcpy(G1.window, G1.par_dict, G1.par_dictlen);
+		G1.strstart = G1.par_dictlen;
+		G1.block_start = G1.par_dictlen;
+	}
+#endif
 
-	G1.lookahead = file_read(G1.window,
-			sizeof(int) <= 2 ? (unsigned) WSIZE : 2 * WSIZE);
+	G1.lookahead = file_read(G1.window + G1.strstart,
+			(sizeof(int) <= 2 ? (unsigned) WSIZE : 2 * WSIZE) - G1.strstart);
 
 	if (G1.lookahead == 0 || G1.lookahead == (unsigned) -1) {
 		G1.eofile = 1;
@@ -1960,6 +2026,14 @@ static void lm_init(ush * flagsp)
 	/* If lookahead < MIN_MATCH, ins_h is garbage, but this is
 	 * not important since only literal bytes will be emitted.
 	 */
+#if ENABLE_FEATURE_GZIP_PARALLEL
+	/* Make dictionary strings available for matching */
+	for (j = 0; j < G1.strstart; j++) {
+		IPos hash_head;
+		INSERT_STRING(j, hash_head);
+		(void)hash_head;
+	}
+#endif
 }
 
 
@@ -2093,6 +2167,131 @@ static void zip(void)
 }
 
 
+#if ENABLE_FEATURE_GZIP_PARALLEL
+/* ===========================================================================
+ * Deflate in to out using G1.par_jobs worker processes.
+ * Parent reads input in PAR_BLOCK chunks and computes crc and size,
+ * each chunk is compressed by a forked worker. Workers' outputs
+ * are collected through pipes, in input order.
+ */
+#define PAR_BLOCK (128 * 1024)
+
+static void zip_parallel(void)
+{
+	struct par_slot {
+		pid_t pid;
+		int fd;
+	} *slot;
+	uch *buf, *cur, *next, *dict;
+	unsigned dictlen;
+	unsigned head_idx, busy;
+	int len;
+
+	slot = xzalloc(G1.par_jobs * sizeof(slot[0]));
+	buf = cur = xmalloc(2 * PAR_BLOCK + WSIZE);
+	next = cur + PAR_BLOCK;
+	dict = next + PAR_BLOCK;
+	dictlen = 0;
+
+	/* Same header as zip() writes (lm_init always sets flags to 2) */
+	G1.outcnt = 0;
+	put_32bit(0x00088b1f);
+	put_32bit(0);		/* Unix timestamp */
+	put_8bit(2);		/* extra flags */
+	put_8bit(3);		/* OS identifier = 3 (Unix) */
+	flush_outbuf();
+	G1.crc = ~0;
+
+	head_idx = busy = 0;
+	len = full_read(ifd, cur, PAR_BLOCK);
+	for (;;) {
+		struct par_slot *sp;
+		int nlen;
+		int fd[2];
+
+		if (len < 0)
+			bb_perror_msg_and_die(bb_msg_read_error);
+		/* Short read means EOF, no need to read again */
+		nlen = 0;
+		if (len == PAR_BLOCK)
+			nlen = full_read(ifd, next, PAR_BLOCK);
+		updcrc(cur, len);
+		G1.isize += len;
+
+		if (busy == G1.par_jobs) {
+			/* All workers busy: wait for the oldest one */
+			sp = &slot[head_idx];
+			bb_copyfd_eof(sp->fd, ofd);
+			close(sp->fd);
+			if (wait4pid(sp->pid) != 0)
+				xfunc_die(); /* worker already said why */
+			head_idx = (head_idx + 1) % G1.par_jobs;
+			busy--;
+		}
+
+		sp = &slot[(head_idx + busy) % G1.par_jobs];
+		xpipe(fd);
+		sp->pid = xfork();
+		if (sp->pid == 0) {
+			/* Worker */
+			ush deflate_flags = 0;
+
+			close(fd[0]);
+			G1.par_worker = 1;
+			G1.par_more = (nlen != 0);
+			G1.par_dict = dict;
+			G1.par_dictlen = dictlen;
+			G1.par_in = cur;
+			G1.par_inlen = len;
+			bi_init();
+			ct_init();
+			lm_init(&deflate_flags);
+			deflate();
+			flush_outbuf();
+			xwrite(fd[1], G1.par_out, G1.par_outlen);
+			_exit(EXIT_SUCCESS);
+		}
+		close(fd[1]);
+		sp->fd = fd[0];
+		busy++;
+
+		if (nlen <= 0) {
+			if (nlen < 0)
+				bb_perror_msg_and_die(bb_msg_read_error);
+			break;
+		}
+		/* Not the last block, therefore it was a full one */
+		dictlen = WSIZE;
+		memcpy(dict, cur + PAR_BLOCK - WSIZE, WSIZE);
+		{
+			uch *t = cur;
+			cur = next;
+			next = t;
+		}
+		len = nlen;
+	}
+
+	while (busy != 0) {
+		struct par_slot *sp = &slot[head_idx];
+		bb_copyfd_eof(sp->fd, ofd);
+		close(sp->fd);
+		if (wait4pid(sp->pid) != 0)
+			xfunc_die();
+		head_idx = (head_idx + 1) % G1.par_jobs;
+		busy--;
+	}
+
+	/* Write the crc and uncompressed size */
+	put_32bit(~G1.crc);
+	put_32bit(G1.isize);
+	flush_outbuf();
+
+	free(buf);
+	free(slot);
+}
+#endif
+
+
 /* ======================================================================== */
 static
 IF_DESKTOP(long long) int FAST_FUNC pack_gzip(transformer_state_t *xstate UNUSED_PARAM)
@@ -2128,6 +2327,12 @@ IF_DESKTOP(long long) int FAST_FUNC pack_gzip(transformer_state_t *xstate UNUSED
 	G2.bl_desc.max_length  = MAX_BL_BITS;
 	//G2.bl_desc.max_code    = 0;
 
+#if ENABLE_FEATURE_GZIP_PARALLEL
+	if (G1.par_jobs > 1) {
+		zip_parallel();
+		return 0;
+	}
+#endif
 #if 0
 	/* Saving of timestamp is disabled. Why?
 	 * - it is not Y2038-safe.
@@ -2163,6 +2368,9 @@ static const char gzip_longopts[] ALIGN1 =
 	"fast\0"                No_argument       "1"
 	"best\0"                No_argument       "9"
 	"no-name\0"             No_argument       "n"
+#if ENABLE_FEATURE_GZIP_PARALLEL
+	"processes\0"           Required_argument "p"
+#endif
 	;
 #endif
 
@@ -2211,13 +2419,16 @@ int gzip_main(int argc UNUSED_PARAM, char **argv)
 	applet_long_options = gzip_longopts;
 #endif
 	/* Must match bbunzip's constants OPT_STDOUT, OPT_FORCE! */
-	opt = getopt32(argv, "cfv" IF_GUNZIP("dt") "qn123456789");
+	opt = getopt32(argv, "cfv" IF_GUNZIP("dt") "qn123456789"
+			IF_FEATURE_GZIP_PARALLEL("p:+")
+			IF_FEATURE_GZIP_PARALLEL(, &G1.par_jobs));
 #if ENABLE_GUNZIP /* gunzip_main may not be visible... */
 	if (opt & 0x18) // -d and/or -t
 		return gunzip_main(argc, argv);
 #endif
 #ifdef ENABLE_FEATURE_GZIP_LEVELS
 	opt >>= ENABLE_GUNZIP ? 7 : 5; /* drop cfv[dt]qn bits */
+	opt &= 0x1ff; /* drop -p bit */
 	if (opt == 0)
 		opt = 1 << 6; /* default: 6 */
 	opt = ffs(opt >> 4); /* Maps -1..-4 to [0], -5 to [1] ... -9 to [5] */
@@ -6,6 +6,27 @@
 #include "libbb.h"
 #include "bb_archive.h"
 
+static void get_owner(archive_handle_t *archive_handle, uid_t *uid, gid_t *gid)
+{
+	file_header_t *file_header = archive_handle->file_header;
+
+	*uid = file_header->uid;
+	*gid = file_header->gid;
+#if ENABLE_FEATURE_TAR_UNAME_GNAME
+	if (!(archive_handle->ah_flags & ARCHIVE_NUMERIC_OWNER)) {
+		if (file_header->tar__uname) {
+//TODO: cache last name/id pair?
+			struct passwd *pwd = getpwnam(file_header->tar__uname);
+			if (pwd) *uid = pwd->pw_uid;
+		}
+		if (file_header->tar__gname) {
+			struct group *grp = getgrnam(file_header->tar__gname);
+			if (grp) *gid = grp->gr_gid;
+		}
+	}
+#endif
+}
+
 void FAST_FUNC data_extract_all(archive_handle_t *archive_handle)
 {
 	file_header_t *file_header = archive_handle->file_header;
@@ -67,6 +88,16 @@ void FAST_FUNC data_extract_all(archive_handle_t *archive_handle)
 	}
 #endif
 
+#if ENABLE_FEATURE_TAR_JOBS
+	if (archive_handle->tar__jobs) {
+		/* Writer processes may still be creating this name,
+		 * a file where we need a directory, or the link target */
+		tar_jobs_sync_for(archive_handle, dst_name);
+		if (hard_link)
+			tar_jobs_sync_for(archive_handle, hard_link);
+	}
+#endif
+
 	if (archive_handle->ah_flags & ARCHIVE_CREATE_LEADING_DIRS) {
 		char *slash = strrchr(dst_name, '/');
 		if (slash) {
@@ -76,6 +107,24 @@ void FAST_FUNC data_extract_all(archive_handle_t *archive_handle)
 		}
 	}
 
+#if ENABLE_FEATURE_TAR_JOBS
+	if (archive_handle->tar__jobs
+	 && S_ISREG(file_header->mode) && !hard_link
+	 && !(archive_handle->ah_flags & ARCHIVE_EXTRACT_NEWER)
+	 IF_FEATURE_TAR_SPARSE(&& !file_header->tar__sparse)
+	 IF_FEATURE_TAR_SELINUX(&& !sctx)
+	) {
+		uid_t uid = file_header->uid;
+		gid_t gid = file_header->gid;
+
+		if (!(archive_handle->ah_flags & ARCHIVE_DONT_RESTORE_OWNER))
+			get_owner(archive_handle, &uid, &gid);
+		/* Writer removes old file, creates, writes, sets attributes */
+		if (tar_jobs_extract_file(archive_handle, dst_name, uid, gid))
+			goto ret;
+	}
+#endif
+
 	if (archive_handle->ah_flags & ARCHIVE_UNLINK_OLD) {
 		/* Remove the entry if it exists */
 		if (!S_ISDIR(file_header->mode)) {
@@ -154,6 +203,11 @@ void FAST_FUNC data_extract_all(archive_handle_t *archive_handle)
 			flags,
 			file_header->mode
 			);
+#if ENABLE_FEATURE_TAR_SPARSE
+		if (file_header->tar__sparse)
+			data_extract_sparse(archive_handle, dst_fd, SPARSE_NEW_FILE);
+		else
+#endif
 		bb_copyfd_exact_size(archive_handle->src_fd, dst_fd, file_header->size);
 		close(dst_fd);
 #ifdef ARCHIVE_REPLACE_VIA_RENAME
@@ -203,22 +257,20 @@ void FAST_FUNC data_extract_all(archive_handle_t *archive_handle)
 	}
 
 	if (!S_ISLNK(file_header->mode)) {
-		if (!(archive_handle->ah_flags & ARCHIVE_DONT_RESTORE_OWNER)) {
-			uid_t uid = file_header->uid;
-			gid_t gid = file_header->gid;
-#if ENABLE_FEATURE_TAR_UNAME_GNAME
-			if (!(archive_handle->ah_flags & ARCHIVE_NUMERIC_OWNER)) {
-				if (file_header->tar__uname) {
-//TODO: cache last name/id pair?
-					struct passwd *pwd = getpwnam(file_header->tar__uname);
-					if (pwd) uid = pwd->pw_uid;
-				}
-				if (file_header->tar__gname) {
-					struct group *grp = getgrnam(file_header->tar__gname);
-					if (grp) gid = grp->gr_gid;
-				}
-			}
+		uid_t uid = file_header->uid;
+		gid_t gid = file_header->gid;
+
+		if (!(archive_handle->ah_flags & ARCHIVE_DONT_RESTORE_OWNER))
+			get_owner(archive_handle, &uid, &gid);
+#if ENABLE_FEATURE_TAR_JOBS
+		if (archive_handle->tar__jobs && S_ISDIR(file_header->mode)) {
+			/* Files are still being created in it, set its mtime
+			 * (and mode, which may not allow that) at the end */
+			tar_jobs_add_dir(archive_handle, dst_name, uid, gid);
+			goto ret;
+		}
 #endif
+		if (!(archive_handle->ah_flags & ARCHIVE_DONT_RESTORE_OWNER)) {
 			/* GNU tar 1.15.1 uses chown, not lchown */
 			chown(dst_name, uid, gid);
 		}
@@ -0,0 +1,425 @@
+/* vi: set sw=4 ts=4: */
+/*
+ * tar -x --jobs N: create and write regular files in N processes.
+ *
+ * Extracting many small files is bound by the latency of open, write,
+ * chown, chmod, utimes and close, not by data. The parent still reads
+ * headers in order and does everything else itself (directories,
+ * symlinks, hardlinks, devices, big files), and hands small regular
+ * files, header and body, to writer processes through pipes.
+ * Memory use is bounded by one job and the pipe buffers.
+ *
+ * Ordering: the parent remembers names of files it handed out.
+ * Before it touches a name which is one of them, or is under one of
+ * them, or hardlinks to one, it waits until writers have done all
+ * jobs they got so far. Directory owner, mode and time are set at
+ * the end, when nothing will be created in them anymore.
+ *
+ * If we die, we wait for writers and fix up directories as far as
+ * we got, as serial extraction would leave them. If a writer failed,
+ * the others drop the jobs they have not started.
+ *
+ * Licensed under GPLv2 or later, see file LICENSE in this source tree.
+ */
+
+#include "libbb.h"
+#include "bb_archive.h"
+
+enum {
+	TAR_JOB_MAX = 256 * 1024, /* bigger files are written by the parent */
+	PENDING_MAX = 4096,       /* wait for writers after so many files */
+	PENDING_SIZE = PENDING_MAX * 2, /* hash table, power of 2 */
+};
+
+struct tar_job {
+	uint32_t size;
+	uint32_t name_len; /* 0: "tell me when you are done" */
+	uid_t uid;
+	gid_t gid;
+	mode_t mode;
+	time_t mtime;
+	/* followed by name and body */
+};
+
+struct tar_dir {
+	struct tar_dir *next;
+	uid_t uid;
+	gid_t gid;
+	mode_t mode;
+	time_t mtime;
+	char name[1];
+};
+
+struct tar_jobs_t {
+	unsigned ah_flags;
+	unsigned n;
+	unsigned next;      /* round robin start */
+	pid_t *pid;
+	int *done_fd;
+	struct pollfd *job_pfd;
+	char *buf;
+	unsigned buf_size;
+	unsigned pending_cnt;
+	char **pending;     /* names of files handed out since last sync */
+	struct tar_dir *dirs;
+	int stop_fd;        /* closed: writers drop the jobs they have */
+	smallint failed;    /* a writer failed */
+};
+
+/* For die_func */
+static struct tar_jobs_t *dying_jobs;
+
+static void restore_attrs(unsigned ah_flags, const char *name, int fd,
+		uid_t uid, gid_t gid, mode_t mode, time_t mtime)
+{
+	if (!(ah_flags & ARCHIVE_DONT_RESTORE_OWNER)) {
+		/* GNU tar 1.15.1 uses chown, not lchown */
+		if (fd >= 0)
+			fchown(fd, uid, gid);
+		else
+			chown(name, uid, gid);
+	}
+	if (!(ah_flags & ARCHIVE_DONT_RESTORE_PERM)) {
+		if (fd >= 0)
+			fchmod(fd, mode);
+		else
+			chmod(name, mode);
+	}
+	if (ah_flags & ARCHIVE_RESTORE_DATE) {
+		struct timespec t[2];
+
+		t[1].tv_sec = t[0].tv_sec = mtime;
+		t[1].tv_nsec = t[0].tv_nsec = 0;
+		if (fd >= 0)
+			futimens(fd, t);
+		else
+			utimensat(AT_FDCWD, name, t, 0);
+	}
+}
+
+static void writer_main(unsigned ah_flags, int job_fd, int done_fd, int stop_fd) NORETURN;
+static void writer_main(unsigned ah_flags, int job_fd, int done_fd, int stop_fd)
+{
+	struct pollfd stop_pfd;
+	struct tar_job job;
+	char *body = xmalloc(TAR_JOB_MAX);
+	int flags = O_WRONLY | O_CREAT | O_EXCL;
+
+	if (ah_flags & ARCHIVE_O_TRUNC)
+		flags = O_WRONLY | O_CREAT | O_TRUNC;
+	stop_pfd.fd = stop_fd;
+	stop_pfd.events = POLLIN;
+
+	while (full_read(job_fd, &job, sizeof(job)) == sizeof(job)) {
+		char *name;
+		int fd;
+
+		if (job.name_len == 0) {
+			xwrite(done_fd, "", 1);
+			continue;
+		}
+		name = xmalloc(job.name_len + 1);
+		xread(job_fd, name, job.name_len);
+		name[job.name_len] = '\0';
+		xread(job_fd, body, job.size);
+		/* Another writer failed, the parent stops */
+		if (poll(&stop_pfd, 1, 0) != 0)
+			_exit(EXIT_FAILURE);
+
+		if ((ah_flags & ARCHIVE_UNLINK_OLD)
+		 && unlink(name) == -1
+		 && errno != ENOENT
+		) {
+			bb_perror_msg_and_die("can't remove old file %s", name);
+		}
+		fd = xopen3(name, flags, job.mode);
+		xwrite(fd, body, job.size);
+		restore_attrs(ah_flags, name, fd, job.uid, job.gid, job.mode, job.mtime);
+		close(fd);
+		free(name);
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/* Writers exit after the jobs they have, or with stop, after
+ * the file they are writing. Returns nonzero if a writer failed */
+static int wait_writers(struct tar_jobs_t *j, int stop)
+{
+	int err = 0;
+	unsigned i;
+
+	if (stop)
+		close(j->stop_fd);
+	for (i = 0; i < j->n; i++)
+		close(j->job_pfd[i].fd);
+	for (i = 0; i < j->n; i++) {
+		int status;
+
+		if (safe_waitpid(j->pid[i], &status, 0) < 0 || status != 0)
+			err = 1;
+		close(j->done_fd[i]);
+	}
+	if (!stop)
+		close(j->stop_fd);
+	return err;
+}
+
+static void fixup_dirs(struct tar_jobs_t *j)
+{
+	/* Innermost, and last seen, first */
+	while (j->dirs) {
+		struct tar_dir *d = j->dirs;
+
+		restore_attrs(j->ah_flags, d->name, -1,
+				d->uid, d->gid, d->mode, d->mtime);
+		j->dirs = d->next;
+		free(d);
+	}
+}
+
+/* We die. Files handed out before were extracted by serial tar too,
+ * unless a writer failed: then it stopped at that file */
+static void tar_jobs_die(void)
+{
+	struct tar_jobs_t *j = dying_jobs;
+
+	die_func = NULL;
+	wait_writers(j, j->failed);
+	fixup_dirs(j);
+}
+
+void FAST_FUNC tar_jobs_start(archive_handle_t *archive_handle, unsigned n)
+{
+	struct tar_jobs_t *j;
+	unsigned i;
+	int stop_rd;
+
+	j = xzalloc(sizeof(*j));
+	j->ah_flags = archive_handle->ah_flags;
+	j->n = n;
+	j->pid = xmalloc(n * sizeof(j->pid[0]));
+	j->done_fd = xmalloc(n * sizeof(j->done_fd[0]));
+	j->job_pfd = xzalloc(n * sizeof(j->job_pfd[0]));
+	j->pending = xzalloc(PENDING_SIZE * sizeof(j->pending[0]));
+	{
+		struct fd_pair stop_pipe;
+		xpiped_pair(stop_pipe);
+		stop_rd = stop_pipe.rd;
+		j->stop_fd = stop_pipe.wr;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct fd_pair job_pipe, done_pipe;
+
+		xpiped_pair(job_pipe);
+		xpiped_pair(done_pipe);
+		j->pid[i] = xfork();
+		if (j->pid[i] == 0) {
+			unsigned k;
+
+			die_func = NULL;
+			/* Others must see EOF when the parent closes their pipes */
+			for (k = 0; k < i; k++) {
+				close(j->job_pfd[k].fd);
+				close(j->done_fd[k]);
+			}
+			close(archive_handle->src_fd);
+			close(j->stop_fd);
+			close(job_pipe.wr);
+			close(done_pipe.rd);
+			writer_main(archive_handle->ah_flags, job_pipe.rd, done_pipe.wr, stop_rd);
+		}
+		close(job_pipe.rd);
+		close(done_pipe.wr);
+		j->job_pfd[i].fd = job_pipe.wr;
+		j->job_pfd[i].events = POLLOUT;
+		j->done_fd[i] = done_pipe.rd;
+	}
+	close(stop_rd);
+	/* A writer which died has already said why */
+	signal(SIGPIPE, SIG_IGN);
+	dying_jobs = j;
+	die_func = tar_jobs_die;
+	archive_handle->tar__jobs = j;
+}
+
+static unsigned hash_name(const char *name, unsigned len)
+{
+	unsigned h = len;
+	while (len--)
+		h = h * 31 + (unsigned char)*name++;
+	return h;
+}
+
+/* Return slot of name[0..len), or of the empty slot where it would go */
+static char **find_pending(struct tar_jobs_t *j, const char *name, unsigned len)
+{
+	unsigned i = hash_name(name, len);
+
+	while (1) {
+		char **p = &j->pending[i & (PENDING_SIZE - 1)];
+		if (!*p || (strncmp(*p, name, len) == 0 && (*p)[len] == '\0'))
+			return p;
+		i++;
+	}
+}
+
+/* A writer died, and has said why */
+static void writers_failed(struct tar_jobs_t *j) NORETURN;
+static void writers_failed(struct tar_jobs_t *j)
+{
+	j->failed = 1;
+	xfunc_die();
+}
+
+/* Wait until writers did all jobs they have */
+static void sync_writers(struct tar_jobs_t *j)
+{
+	static const struct tar_job sync_job; /* all zeros */
+	unsigned i;
+	char c;
+
+	for (i = 0; i < j->n; i++)
+		if (full_write(j->job_pfd[i].fd, &sync_job, sizeof(sync_job)) != sizeof(sync_job))
+			writers_failed(j);
+	for (i = 0; i < j->n; i++)
+		if (safe_read(j->done_fd[i], &c, 1) != 1)
+			writers_failed(j);
+
+	for (i = 0; i < PENDING_SIZE; i++) {
+		free(j->pending[i]);
+		j->pending[i] = NULL;
+	}
+	j->pending_cnt = 0;
+}
+
+/* Called before the parent creates, removes or links to name */
+void FAST_FUNC tar_jobs_sync_for(archive_handle_t *archive_handle, const char *name)
+{
+	struct tar_jobs_t *j = archive_handle->tar__jobs;
+	const char *p = name;
+
+	if (!j->pending_cnt)
+		return;
+	/* Is name, or a directory on its path, a file being written? */
+	while (1) {
+		const char *slash = strchr(p, '/');
+		unsigned len = slash ? slash - name : strlen(name);
+
+		if (len && *find_pending(j, name, len)) {
+			sync_writers(j);
+			return;
+		}
+		if (!slash || !slash[1])
+			return;
+		p = slash + 1;
+	}
+}
+
+/* Hand a regular file over to a writer. Returns 0 if it is too big,
+ * then the caller writes it itself */
+int FAST_FUNC tar_jobs_extract_file(archive_handle_t *archive_handle,
+		const char *dst_name, uid_t uid, gid_t gid)
+{
+	struct tar_jobs_t *j = archive_handle->tar__jobs;
+	file_header_t *file_header = archive_handle->file_header;
+	struct tar_job *job;
+	unsigned name_len, len, i, k = 0;
+	char **slot;
+
+	if (file_header->size > TAR_JOB_MAX)
+		return 0;
+	/* With -k, an existing file is an error which must stop us
+	 * before files after it are created: leave it to the caller
+	 * once the files before it are written */
+	if (!(archive_handle->ah_flags & (ARCHIVE_O_TRUNC | ARCHIVE_UNLINK_OLD))) {
+		struct stat st;
+		if (lstat(dst_name, &st) == 0) {
+			sync_writers(j);
+			return 0;
+		}
+	}
+
+	name_len = strlen(dst_name);
+	len = sizeof(*job) + name_len + file_header->size;
+	if (len > j->buf_size) {
+		j->buf_size = len;
+		j->buf = xrealloc(j->buf, len);
+	}
+	job = (void*)j->buf;
+	job->size = file_header->size;
+	job->name_len = name_len;
+	job->uid = uid;
+	job->gid = gid;
+	job->mode = file_header->mode;
+	job->mtime = file_header->mtime;
+	memcpy(job + 1, dst_name, name_len);
+	xread(archive_handle->src_fd, j->buf + sizeof(*job) + name_len, file_header->size);
+
+	/* First writer (after the last one used) with room in its pipe.
+	 * If any writer is gone, its pipe has POLLERR */
+	safe_poll(j->job_pfd, j->n, -1);
+	for (i = 0; i < j->n; i++)
+		if (j->job_pfd[i].revents & (POLLERR | POLLHUP))
+			writers_failed(j);
+	for (i = 0; i < j->n; i++) {
+		k = (j->next + i) % j->n;
+		if (j->job_pfd[k].revents)
+			break;
+	}
+	j->next = k + 1;
+	if (full_write(j->job_pfd[k].fd, job, len) != (ssize_t)len)
+		writers_failed(j);
+
+	if (j->pending_cnt >= PENDING_MAX)
+		sync_writers(j);
+	slot = find_pending(j, dst_name, name_len);
+	if (!*slot) {
+		*slot = xstrdup(dst_name);
+		j->pending_cnt++;
+	}
+	return 1;
+}
+
+void FAST_FUNC tar_jobs_add_dir(archive_handle_t *archive_handle,
+		const char *dst_name, uid_t uid, gid_t gid)
+{
+	struct tar_jobs_t *j = archive_handle->tar__jobs;
+	file_header_t *file_header = archive_handle->file_header;
+	struct tar_dir *d;
+
+	d = xmalloc(sizeof(*d) + strlen(dst_name));
+	strcpy(d->name, dst_name);
+	d->uid = uid;
+	d->gid = gid;
+	d->mode = file_header->mode;
+	d->mtime = file_header->mtime;
+	d->next = j->dirs;
+	j->dirs = d;
+}
+
+/* Wait for writers, then fix up directories.
+ * Returns nonzero if a writer failed */
+int FAST_FUNC tar_jobs_finish(archive_handle_t *archive_handle)
+{
+	struct tar_jobs_t *j = archive_handle->tar__jobs;
+	int err;
+	unsigned i;
+
+	die_func = NULL;
+	err = wait_writers(j, 0);
+	fixup_dirs(j);
+
+	if (ENABLE_FEATURE_CLEAN_UP) {
+		for (i = 0; i < PENDING_SIZE; i++)
+			free(j->pending[i]);
+		free(j->pending);
+		free(j->pid);
+		free(j->done_fd);
+		free(j->job_pfd);
+		free(j->buf);
+		free(j);
+	}
+	archive_handle->tar__jobs = NULL;
+	return err;
+}
@@ -0,0 +1,55 @@
+/* vi: set sw=4 ts=4: */
+/*
+ * Licensed under GPLv2 or later, see file LICENSE in this source tree.
+ */
+
+#include "libbb.h"
+#include "bb_archive.h"
+
+/* Write out the data of a GNU sparse member: each extent goes
+ * to its offset in the file. With SPARSE_NEW_FILE we seek over
+ * the gaps, leaving holes, else (stdout, pipe) we write zeros.
+ */
+void FAST_FUNC data_extract_sparse(archive_handle_t *archive_handle, int dst_fd, unsigned flags)
+{
+	file_header_t *file_header = archive_handle->file_header;
+	char *zeros = NULL;
+	off_t pos = 0;
+	unsigned i;
+
+	for (i = 0; i <= file_header->tar__sparse_cnt; i++) {
+		off_t offset, numbytes;
+
+		/* After the last extent, "extent" of 0 bytes at the end */
+		offset = file_header->tar__realsize;
+		numbytes = 0;
+		if (i < file_header->tar__sparse_cnt) {
+			offset = file_header->tar__sparse[i].offset;
+			numbytes = file_header->tar__sparse[i].numbytes;
+		}
+		if (flags & SPARSE_NEW_FILE) {
+			xlseek(dst_fd, offset, SEEK_SET);
+		} else {
+			while (pos < offset) {
+				size_t n = 4096;
+				if (n > offset - pos)
+					n = offset - pos;
+				if (!zeros)
+					zeros = xzalloc(4096);
+				if (full_write(dst_fd, zeros, n) != (ssize_t)n
+				 && !(flags & SPARSE_IGNORE_WRITE_ERRORS)
+				) {
+					bb_perror_msg_and_die(bb_msg_write_error);
+				}
+				pos += n;
+			}
+		}
+		bb_copyfd_exact_size(archive_handle->src_fd, dst_fd,
+			(flags & SPARSE_IGNORE_WRITE_ERRORS) ? -numbytes : numbytes);
+		pos = offset + numbytes;
+	}
+	/* File can end in a hole */
+	if ((flags & SPARSE_NEW_FILE) && ftruncate(dst_fd, pos) != 0)
+		bb_perror_msg_and_die(bb_msg_write_error);
+	free(zeros);
+}
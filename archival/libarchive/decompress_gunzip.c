@@ -89,6 +89,31 @@ typedef struct state_t {
 //	unsigned bytebuffer_max;        /* buffer size */
 	unsigned bytebuffer_offset;     /* buffer position */
 	unsigned bytebuffer_size;       /* how much data is there (size <= max) */
+#if ENABLE_FEATURE_GUNZIP_PARALLEL || ENABLE_FEATURE_GUNZIP_INDEX
+	off_t src_pos;                  /* input offset of bytebuffer[bytebuffer_size] */
+#endif
+#if ENABLE_FEATURE_GUNZIP_PARALLEL
+	/* parallel workers pread() the input, stop after the member
+	 * which ends at or past src_end */
+	smallint src_pread;
+	off_t src_end;
+	/* a member had incorrect length: unlike other errors,
+	 * members after it are still inflated */
+	smallint bad_length;
+#endif
+#if ENABLE_FEATURE_GUNZIP_INDEX
+	/* gunzip --index: write a checkpoint to index_fd at the first
+	 * block boundary at or past output offset index_next (0: don't) */
+	int index_fd;
+	off_t index_next;
+	off_t out_base;                 /* output of the previous members */
+	/* zcat --offset/--length */
+	off_t out_skip;                 /* drop this many output bytes */
+	off_t out_left;                 /* stop after this many, if out_limit */
+	smallint out_limit;
+	unsigned resume_bits;           /* start mid-member from a checkpoint: */
+	unsigned char *resume_window;   /* bit offset in first byte, last 32K of output */
+#endif
 
 	/* private data of inflate_codes() */
 	unsigned inflate_codes_ml; /* masks for bl and bd bits */
@@ -102,6 +127,13 @@ typedef struct state_t {
 	unsigned inflate_codes_bd;
 	unsigned inflate_codes_nn; /* length and index for copy */
 	unsigned inflate_codes_dd;
+#if ENABLE_FEATURE_GUNZIP_FAST
+	/* tables for fixed Huffman codes, built once per stream */
+	huft_t *fixed_tl;
+	huft_t *fixed_td;
+	unsigned fixed_bl;
+	unsigned fixed_bd;
+#endif
 
 	smallint resume_copy;
 
@@ -134,6 +166,18 @@ typedef struct state_t {
 #define bytebuffer          (S()bytebuffer         )
 #define bytebuffer_offset   (S()bytebuffer_offset  )
 #define bytebuffer_size     (S()bytebuffer_size    )
+#define src_pread           (S()src_pread          )
+#define src_pos             (S()src_pos            )
+#define src_end             (S()src_end            )
+#define bad_length          (S()bad_length         )
+#define index_fd            (S()index_fd           )
+#define index_next          (S()index_next         )
+#define out_base            (S()out_base           )
+#define out_skip            (S()out_skip           )
+#define out_left            (S()out_left           )
+#define out_limit           (S()out_limit          )
+#define resume_bits         (S()resume_bits        )
+#define resume_window       (S()resume_window      )
 #define inflate_codes_ml    (S()inflate_codes_ml   )
 #define inflate_codes_md    (S()inflate_codes_md   )
 #define inflate_codes_bb    (S()inflate_codes_bb   )
@@ -145,6 +189,10 @@ typedef struct state_t {
 #define inflate_codes_bd    (S()inflate_codes_bd   )
 #define inflate_codes_nn    (S()inflate_codes_nn   )
 #define inflate_codes_dd    (S()inflate_codes_dd   )
+#define fixed_tl            (S()fixed_tl           )
+#define fixed_td            (S()fixed_td           )
+#define fixed_bl            (S()fixed_bl           )
+#define fixed_bd            (S()fixed_bd           )
 #define resume_copy         (S()resume_copy        )
 #define method              (S()method             )
 #define need_another_block  (S()need_another_block )
@@ -238,8 +286,16 @@ static void huft_free(huft_t *p)
 
 static void huft_free_all(STATE_PARAM_ONLY)
 {
+#if ENABLE_FEATURE_GUNZIP_FAST
+	/* fixed tables are freed at the end of the stream */
+	if (inflate_codes_tl != fixed_tl)
+		huft_free(inflate_codes_tl);
+	if (inflate_codes_td != fixed_td)
+		huft_free(inflate_codes_td);
+#else
 	huft_free(inflate_codes_tl);
 	huft_free(inflate_codes_td);
+#endif
 	inflate_codes_tl = NULL;
 	inflate_codes_td = NULL;
 }
@@ -251,6 +307,25 @@ static void abort_unzip(STATE_PARAM_ONLY)
 	longjmp(error_jmp, 1);
 }
 
+/* Read compressed data. For a regular file, a single pread() returns
+ * less than asked only at EOF, so this can stand in for full_read() too */
+static ssize_t read_src(STATE_PARAM void *buf, size_t count)
+{
+	ssize_t n;
+
+#if ENABLE_FEATURE_GUNZIP_PARALLEL
+	if (src_pread)
+		n = pread(gunzip_src_fd, buf, count, src_pos);
+	else
+#endif
+	n = safe_read(gunzip_src_fd, buf, count);
+#if ENABLE_FEATURE_GUNZIP_PARALLEL || ENABLE_FEATURE_GUNZIP_INDEX
+	if (n > 0)
+		src_pos += n;
+#endif
+	return n;
+}
+
 static unsigned fill_bitbuffer(STATE_PARAM unsigned bitbuffer, unsigned *current, const unsigned required)
 {
 	while (*current < required) {
@@ -260,7 +335,7 @@ static unsigned fill_bitbuffer(STATE_PARAM unsigned bitbuffer, unsigned *current
 				sz = to_read;
 			/* Leave the first 4 bytes empty so we can always unwind the bitbuffer
 			 * to the front of the bytebuffer */
-			bytebuffer_size = safe_read(gunzip_src_fd, &bytebuffer[4], sz);
+			bytebuffer_size = read_src(PASS_STATE &bytebuffer[4], sz);
 			if ((int)bytebuffer_size < 1) {
 				error_msg = "unexpected end of file";
 				abort_unzip(PASS_STATE_ONLY);
@@ -508,6 +583,174 @@ static void inflate_codes_setup(STATE_PARAM unsigned my_bl, unsigned my_bd)
 	ml = mask_bits[bl];		/* precompute masks for speed */
 	md = mask_bits[bd];
 }
+#if ENABLE_FEATURE_GUNZIP_FAST
+enum {
+	/* bits in the fast path bit buffer */
+	FAST_BITS = sizeof(long) * 8,
+	/* input bytes a single literal/length + distance pair can read */
+	FAST_IN_MARGIN = 16,
+	/* longest match */
+	FAST_OUT_MARGIN = 258,
+};
+
+/* Copy len bytes from dist bytes back, the areas may overlap */
+static ALWAYS_INLINE void copy_match(unsigned char *out, unsigned dist, unsigned len)
+{
+	const unsigned char *from = out - dist;
+
+	if (dist >= sizeof(long)) {
+		/* every word is read after it was written */
+		while (len >= sizeof(long)) {
+			memcpy(out, from, sizeof(long));
+			out += sizeof(long);
+			from += sizeof(long);
+			len -= sizeof(long);
+		}
+	} else if (dist == 1) {
+		memset(out, *from, len);
+		return;
+	}
+	while (len) {
+		*out++ = *from++;
+		len--;
+	}
+}
+
+/* Decode codes while there is enough input in bytebuffer and room
+ * in gunzip_window for the longest match, like inflate_fast() in zlib:
+ * the bit buffer is a long refilled a word at a time straight from
+ * bytebuffer, and the loop has no fill_bitbuffer() calls and no
+ * checks for the window end.
+ * Returns 1 if end of block was reached.
+ */
+static int inflate_codes_fast(STATE_PARAM_ONLY)
+{
+	unsigned char *win = gunzip_window;
+	unsigned char *in = bytebuffer + bytebuffer_offset;
+	const unsigned char *in_end = bytebuffer + bytebuffer_size - FAST_IN_MARGIN;
+	unsigned long hold = bb;
+	unsigned bits = k;
+	unsigned pos = w;
+	int eob = 0;
+
+/* The branchless refill: the bytes above "bits" which are already
+ * in hold are ORed with the same values again */
+#if BB_LITTLE_ENDIAN
+# define REFILL() do { \
+	unsigned long v; \
+	move_from_unaligned_long(v, in); \
+	hold |= v << bits; \
+	in += (FAST_BITS - 1 - bits) >> 3; \
+	bits |= FAST_BITS - 8; \
+} while (0)
+#else
+# define REFILL() do { \
+	while (bits <= FAST_BITS - 8) { \
+		hold |= (unsigned long)*in++ << bits; \
+		bits += 8; \
+	} \
+} while (0)
+#endif
+/* After REFILL, a 64-bit hold has enough bits for a whole
+ * length/distance pair (15+5+15+13 bits), a 32-bit one does not */
+#define NEEDBITS(n) do { \
+	if (FAST_BITS < 64 && bits < (n)) \
+		REFILL(); \
+} while (0)
+#define DROPBITS(n) do { \
+	hold >>= (n); \
+	bits -= (n); \
+} while (0)
+
+	while (in < in_end && pos < GUNZIP_WSIZE - FAST_OUT_MARGIN) {
+		huft_t *t;
+		unsigned e;
+		unsigned len;
+		unsigned dist;
+
+		REFILL();
+		t = tl + ((unsigned) hold & ml);
+		e = t->e;
+		while (e > 16) {
+			if (e == 99)
+				abort_unzip(PASS_STATE_ONLY);
+			DROPBITS(t->b);
+			e -= 16;
+			t = t->v.t + ((unsigned) hold & mask_bits[e]);
+			e = t->e;
+		}
+		DROPBITS(t->b);
+		if (e == 16) {	/* literal */
+			win[pos++] = (unsigned char) t->v.n;
+			continue;
+		}
+		if (e == 15) {	/* end of block */
+			eob = 1;
+			break;
+		}
+
+		/* length */
+		NEEDBITS(5);
+		len = t->v.n + ((unsigned) hold & mask_bits[e]);
+		DROPBITS(e);
+
+		/* distance */
+		NEEDBITS(15);
+		t = td + ((unsigned) hold & md);
+		e = t->e;
+		while (e > 16) {
+			if (e == 99)
+				abort_unzip(PASS_STATE_ONLY);
+			DROPBITS(t->b);
+			e -= 16;
+			t = t->v.t + ((unsigned) hold & mask_bits[e]);
+			e = t->e;
+		}
+		DROPBITS(t->b);
+		NEEDBITS(13);
+		dist = t->v.n + ((unsigned) hold & mask_bits[e]);
+		DROPBITS(e);
+
+		if (dist > pos) {
+			/* Source starts in the old data at the end of the window.
+			 * It is never behind the destination, so memmove
+			 * does what a forward byte copy would */
+			unsigned from = (pos - dist) & (GUNZIP_WSIZE - 1);
+			unsigned n = GUNZIP_WSIZE - from;
+
+			if (n > len)
+				n = len;
+			memmove(win + pos, win + from, n);
+			pos += n;
+			len -= n;
+		}
+		copy_match(win + pos, dist, len);
+		pos += len;
+	}
+#undef REFILL
+#undef NEEDBITS
+#undef DROPBITS
+
+	/* Give whole unused bytes back to bytebuffer. The 4 spare bytes
+	 * at its start leave room for those which were in bb on entry */
+	{
+		unsigned n = bits >> 3;
+		unsigned i;
+
+		bits &= 7;
+		in -= n;
+		for (i = 0; i < n; i++)
+			in[i] = hold >> (bits + 8 * i);
+		hold &= (1 << bits) - 1;
+	}
+	bytebuffer_offset = in - bytebuffer;
+	bb = hold;
+	k = bits;
+	w = pos;
+	return eob;
+}
+#endif
+
 /* called once from inflate_get_next_window */
 static NOINLINE int inflate_codes(STATE_PARAM_ONLY)
 {
@@ -518,6 +761,14 @@ static NOINLINE int inflate_codes(STATE_PARAM_ONLY)
 		goto do_copy;
 
 	while (1) {			/* do until end of block */
+#if ENABLE_FEATURE_GUNZIP_FAST
+		if (w < GUNZIP_WSIZE - FAST_OUT_MARGIN
+		 && bytebuffer_size - bytebuffer_offset > FAST_IN_MARGIN
+		) {
+			if (inflate_codes_fast(PASS_STATE_ONLY))
+				break; /* end of block */
+		}
+#endif
 		bb = fill_bitbuffer(PASS_STATE bb, &k, bl);
 		t = tl + ((unsigned) bb & ml);
 		e = t->e;
@@ -754,7 +1005,8 @@ static int inflate_block(STATE_PARAM smallint *e)
 	/* Inflate fixed
 	 * decompress an inflated type 1 (fixed Huffman codes) block. We should
 	 * either replace this with a custom decoder, or at least precompute the
-	 * Huffman tables. TODO */
+	 * Huffman tables. TODO
+	 * With FEATURE_GUNZIP_FAST, tables are built once per stream. */
 	{
 		int i;                  /* temporary variable */
 		unsigned bl;            /* lookup bits for tl */
@@ -762,6 +1014,14 @@ static int inflate_block(STATE_PARAM smallint *e)
 		/* gcc 4.2.1 is too dumb to reuse stackspace. Moved up... */
 		//unsigned ll[288];     /* length list for huft_build */
 
+#if ENABLE_FEATURE_GUNZIP_FAST
+		if (fixed_tl) {
+			inflate_codes_tl = fixed_tl;
+			inflate_codes_td = fixed_td;
+			inflate_codes_setup(PASS_STATE fixed_bl, fixed_bd);
+			return -2;
+		}
+#endif
 		/* set up literal table */
 		for (i = 0; i < 144; i++)
 			ll[i] = 8;
@@ -780,6 +1040,12 @@ static int inflate_block(STATE_PARAM smallint *e)
 			ll[i] = 5;
 		bd = 5;
 		huft_build(ll, 30, 0, cpdist, cpdext, &inflate_codes_td, &bd);
+#if ENABLE_FEATURE_GUNZIP_FAST
+		fixed_tl = inflate_codes_tl;
+		fixed_td = inflate_codes_td;
+		fixed_bl = bl;
+		fixed_bd = bd;
+#endif
 
 		/* set up data for inflate_codes() */
 		inflate_codes_setup(PASS_STATE bl, bd);
@@ -940,6 +1206,51 @@ static void calculate_gunzip_crc(STATE_PARAM_ONLY)
 	gunzip_bytes_out += gunzip_outbuf_count;
 }
 
+#if ENABLE_FEATURE_GUNZIP_INDEX
+/* Index file (FILE.gz.idx): a header, then checkpoints, each followed
+ * by the 32K of output before it. Numbers are little-endian.
+ * Same idea as zran.c in zlib's examples, without compressing windows */
+#define GZ_INDEX_MAGIC "BBGZIDX1"
+enum { GZ_INDEX_SPAN = 1024 * 1024 }; /* output bytes between checkpoints */
+struct gz_index_header {
+	char magic[8];
+	uint64_t size;  /* size and mtime of .gz file, to detect stale index */
+	uint64_t mtime;
+};
+struct gz_index_point {
+	uint64_t out;   /* uncompressed offset */
+	uint64_t in;    /* compressed offset of the byte with the next bit */
+	uint32_t bits;  /* bits of that byte which are already used */
+	uint32_t pad;
+};
+
+/* Called at a block boundary */
+static void gz_index_checkpoint(STATE_PARAM_ONLY)
+{
+	struct gz_index_point pt;
+	unsigned w = gunzip_outbuf_count;
+	off_t out = gunzip_bytes_out + w;
+	off_t in;
+
+	/* Not enough output in this member to fill the window yet? */
+	if (out < GUNZIP_WSIZE)
+		return;
+	out += out_base;
+	if (out < index_next)
+		return;
+	in = (src_pos - (bytebuffer_size - bytebuffer_offset)) * 8 - gunzip_bk;
+	pt.out = SWAP_LE64(out);
+	pt.in = SWAP_LE64(in >> 3);
+	pt.bits = SWAP_LE32(in & 7);
+	pt.pad = 0;
+	xwrite(index_fd, &pt, sizeof(pt));
+	/* window is circular, oldest byte is at w */
+	xwrite(index_fd, gunzip_window + w, GUNZIP_WSIZE - w);
+	xwrite(index_fd, gunzip_window, w);
+	index_next = out + GZ_INDEX_SPAN;
+}
+#endif
+
 /* One callsite in inflate_unzip_internal */
 static int inflate_get_next_window(STATE_PARAM_ONLY)
 {
@@ -955,6 +1266,10 @@ static int inflate_get_next_window(STATE_PARAM_ONLY)
 				/* NB: need_another_block is still set */
 				return 0; /* Last block */
 			}
+#if ENABLE_FEATURE_GUNZIP_INDEX
+			if (index_next)
+				gz_index_checkpoint(PASS_STATE_ONLY);
+#endif
 			method = inflate_block(PASS_STATE &end_reached);
 			need_another_block = 0;
 		}
@@ -1011,10 +1326,38 @@ inflate_unzip_internal(STATE_PARAM transformer_state_t *xstate)
 		n = -1;
 		goto ret;
 	}
+#if ENABLE_FEATURE_GUNZIP_INDEX
+	if (resume_window) {
+		/* Start in the middle of the member, at a checkpoint.
+		 * The source is positioned at the byte with its first bit */
+		unsigned k = 0;
+
+		memcpy(gunzip_window, resume_window, GUNZIP_WSIZE);
+		gunzip_bb = fill_bitbuffer(PASS_STATE 0, &k, 8) >> resume_bits;
+		gunzip_bk = k - resume_bits;
+	}
+#endif
 
 	while (1) {
 		int r = inflate_get_next_window(PASS_STATE_ONLY);
-		nwrote = transformer_write(xstate, gunzip_window, gunzip_outbuf_count);
+		unsigned char *out = gunzip_window;
+		unsigned count = gunzip_outbuf_count;
+#if ENABLE_FEATURE_GUNZIP_INDEX
+		if (out_skip) {
+			unsigned skip = out_skip < count ? (unsigned)out_skip : count;
+			out += skip;
+			count -= skip;
+			out_skip -= skip;
+		}
+		if (out_limit) {
+			if (count > out_left)
+				count = out_left;
+			out_left -= count;
+			if (out_left == 0)
+				r = 0; /* don't inflate the rest */
+		}
+#endif
+		nwrote = transformer_write(xstate, out, count);
 		if (nwrote == (ssize_t)-1) {
 			n = -1;
 			goto ret;
@@ -1036,6 +1379,12 @@ inflate_unzip_internal(STATE_PARAM transformer_state_t *xstate)
 	/* Cleanup */
 	free(gunzip_window);
 	free(gunzip_crc_table);
+#if ENABLE_FEATURE_GUNZIP_FAST
+	huft_free(fixed_tl);
+	huft_free(fixed_td);
+	fixed_tl = NULL;
+	fixed_td = NULL;
+#endif
 	return n;
 }
 
@@ -1078,7 +1427,18 @@ static int top_up(STATE_PARAM unsigned n)
 	if (count < (int)n) {
 		memmove(bytebuffer, &bytebuffer[bytebuffer_offset], count);
 		bytebuffer_offset = 0;
-		bytebuffer_size = full_read(gunzip_src_fd, &bytebuffer[count], bytebuffer_max - count);
+#if ENABLE_FEATURE_GUNZIP_PARALLEL
+		if (src_pread)
+			bytebuffer_size = read_src(PASS_STATE &bytebuffer[count], bytebuffer_max - count);
+		else
+#endif
+		{
+			bytebuffer_size = full_read(gunzip_src_fd, &bytebuffer[count], bytebuffer_max - count);
+#if ENABLE_FEATURE_GUNZIP_INDEX
+			if ((int)bytebuffer_size > 0)
+				src_pos += bytebuffer_size;
+#endif
+		}
 		if ((int)bytebuffer_size < 0) {
 			bb_error_msg(bb_msg_read_error);
 			return 0;
@@ -1196,11 +1556,87 @@ static int check_header_gzip(STATE_PARAM transformer_state_t *xstate)
 #pragma pack()
 #endif
 
-IF_DESKTOP(long long) int FAST_FUNC
-unpack_gz_stream(transformer_state_t *xstate)
+/* Inflate gzip members until EOF or trailing garbage.
+ * The magic of the first one is already consumed */
+static IF_DESKTOP(long long) int
+unpack_gz_members(STATE_PARAM transformer_state_t *xstate)
 {
 	uint32_t v32;
 	IF_DESKTOP(long long) int total, n;
+
+	total = 0;
+ again:
+	if (IF_FEATURE_GUNZIP_INDEX(!resume_window &&) !check_header_gzip(PASS_STATE xstate)) {
+		bb_error_msg("corrupted data");
+		goto bad;
+	}
+
+	n = inflate_unzip_internal(PASS_STATE xstate);
+	if (n < 0)
+		goto bad;
+	total += n;
+#if ENABLE_FEATURE_GUNZIP_INDEX
+	out_base += gunzip_bytes_out;
+	if (out_limit && out_left == 0)
+		return total;
+#endif
+
+	if (!top_up(PASS_STATE 8)) {
+		bb_error_msg("corrupted data");
+		goto bad;
+	}
+#if ENABLE_FEATURE_GUNZIP_INDEX
+	if (resume_window) {
+		/* Started from a checkpoint: crc and length
+		 * of the member can't be checked */
+		resume_window = NULL;
+		bytebuffer_offset += 8;
+		goto next_member;
+	}
+#endif
+
+	/* Validate decompression - crc */
+	v32 = buffer_read_le_u32(PASS_STATE_ONLY);
+	if ((~gunzip_crc) != v32) {
+		bb_error_msg("crc error");
+		goto bad;
+	}
+
+	/* Validate decompression - size */
+	v32 = buffer_read_le_u32(PASS_STATE_ONLY);
+	if ((uint32_t)gunzip_bytes_out != v32) {
+		bb_error_msg("incorrect length");
+		total = -1;
+		IF_FEATURE_GUNZIP_PARALLEL(bad_length = 1;)
+	}
+
+ IF_FEATURE_GUNZIP_INDEX(next_member:)
+#if ENABLE_FEATURE_GUNZIP_PARALLEL
+	/* Parallel worker: did we reach the end of our part? */
+	if (src_pread && src_pos - (bytebuffer_size - bytebuffer_offset) >= src_end)
+		return total;
+#endif
+	if (!top_up(PASS_STATE 2))
+		return total; /* EOF */
+
+	if (bytebuffer[bytebuffer_offset] == 0x1f
+	 && bytebuffer[bytebuffer_offset + 1] == 0x8b
+	) {
+		bytebuffer_offset += 2;
+		goto again;
+	}
+	/* GNU gzip says: */
+	/*bb_error_msg("decompression OK, trailing garbage ignored");*/
+	return total;
+ bad:
+	IF_FEATURE_GUNZIP_PARALLEL(bad_length = 0;)
+	return -1;
+}
+
+IF_DESKTOP(long long) int FAST_FUNC
+unpack_gz_stream(transformer_state_t *xstate)
+{
+	IF_DESKTOP(long long) int total;
 	DECLARE_STATE;
 
 #if !ENABLE_FEATURE_SEAMLESS_Z
@@ -1224,63 +1660,438 @@ unpack_gz_stream(transformer_state_t *xstate)
 	}
 #endif
 
-	total = 0;
-
 	ALLOC_STATE;
 	to_read = -1;
 //	bytebuffer_max = 0x8000;
 	bytebuffer = xmalloc(bytebuffer_max);
 	gunzip_src_fd = xstate->src_fd;
 
- again:
-	if (!check_header_gzip(PASS_STATE xstate)) {
-		bb_error_msg("corrupted data");
-		total = -1;
-		goto ret;
+	total = unpack_gz_members(PASS_STATE xstate);
+
+	free(bytebuffer);
+	DEALLOC_STATE;
+	return total;
+}
+
+#if ENABLE_FEATURE_GUNZIP_INDEX
+/* gunzip --index: inflate src_fd (positioned at the start),
+ * discarding output, and write checkpoints to idx_fd */
+int FAST_FUNC gz_index_build(transformer_state_t *xstate, int idx_fd)
+{
+	struct gz_index_header hdr;
+	struct stat st;
+	int r;
+	DECLARE_STATE;
+
+	if (check_signature16(xstate, GZIP_MAGIC))
+		return -1;
+
+	xfstat(xstate->src_fd, &st, "input");
+	memcpy(hdr.magic, GZ_INDEX_MAGIC, sizeof(hdr.magic));
+	hdr.size = SWAP_LE64((uint64_t)st.st_size);
+	hdr.mtime = SWAP_LE64((uint64_t)st.st_mtime);
+	xwrite(idx_fd, &hdr, sizeof(hdr));
+
+	ALLOC_STATE;
+	to_read = -1;
+	bytebuffer = xmalloc(bytebuffer_max);
+	gunzip_src_fd = xstate->src_fd;
+	src_pos = 2;
+	index_fd = idx_fd;
+	index_next = GZ_INDEX_SPAN;
+	out_skip = OFF_T_MAX;
+
+	r = unpack_gz_members(PASS_STATE xstate) < 0 ? -1 : 0;
+
+	free(bytebuffer);
+	DEALLOC_STATE;
+	return r;
+}
+
+/* Find the last checkpoint at or before offset.
+ * Returns 0 if there is none, or the index is stale */
+static int gz_index_find(int src_fd, int idx_fd, off_t offset,
+		struct gz_index_point *found, unsigned char *window)
+{
+	struct gz_index_header hdr;
+	struct gz_index_point pt;
+	struct stat st;
+	off_t window_pos = -1;
+
+	if (full_read(idx_fd, &hdr, sizeof(hdr)) != sizeof(hdr)
+	 || memcmp(hdr.magic, GZ_INDEX_MAGIC, sizeof(hdr.magic)) != 0
+	) {
+		bb_error_msg("bad index, ignored");
+		return 0;
 	}
+	if (fstat(src_fd, &st) != 0
+	 || SWAP_LE64(hdr.size) != (uint64_t)st.st_size
+	 || SWAP_LE64(hdr.mtime) != (uint64_t)st.st_mtime
+	) {
+		bb_error_msg("stale index, ignored");
+		return 0;
+	}
+	while (full_read(idx_fd, &pt, sizeof(pt)) == sizeof(pt)) {
+		if ((off_t)SWAP_LE64(pt.out) > offset)
+			break;
+		/* Used bits of the byte at pt.in: 0..7 */
+		if (SWAP_LE32(pt.bits) > 7) {
+			bb_error_msg("bad index, ignored");
+			return 0;
+		}
+		*found = pt;
+		window_pos = lseek(idx_fd, GUNZIP_WSIZE, SEEK_CUR) - GUNZIP_WSIZE;
+	}
+	if (window_pos < 0
+	 || lseek(idx_fd, window_pos, SEEK_SET) != window_pos
+	 || full_read(idx_fd, window, GUNZIP_WSIZE) != GUNZIP_WSIZE
+	) {
+		return 0;
+	}
+	found->out = SWAP_LE64(found->out);
+	found->in = SWAP_LE64(found->in);
+	found->bits = SWAP_LE32(found->bits);
+	return 1;
+}
 
-	n = inflate_unzip_internal(PASS_STATE xstate);
-	if (n < 0) {
+/* zcat --offset/--length: write length bytes (all if < 0) of uncompressed
+ * data starting at offset. If idx_fd >= 0, start from a checkpoint in it */
+IF_DESKTOP(long long) int FAST_FUNC
+unpack_gz_range(transformer_state_t *xstate, int idx_fd, off_t offset, off_t length)
+{
+	IF_DESKTOP(long long) int total = 0;
+	struct gz_index_point pt;
+	unsigned char *window = NULL;
+	DECLARE_STATE;
+
+	if (length == 0)
+		return 0;
+
+	ALLOC_STATE;
+	if (idx_fd >= 0) {
+		window = xmalloc(GUNZIP_WSIZE);
+		if (gz_index_find(xstate->src_fd, idx_fd, offset, &pt, window)) {
+			xlseek(xstate->src_fd, pt.in, SEEK_SET);
+			src_pos = pt.in;
+			out_base = pt.out;
+			offset -= pt.out;
+			resume_bits = pt.bits;
+			resume_window = window;
+		}
+	}
+	if (!resume_window && check_signature16(xstate, GZIP_MAGIC)) {
 		total = -1;
 		goto ret;
 	}
-	total += n;
 
-	if (!top_up(PASS_STATE 8)) {
-		bb_error_msg("corrupted data");
-		total = -1;
-		goto ret;
+	to_read = -1;
+	bytebuffer = xmalloc(bytebuffer_max);
+	gunzip_src_fd = xstate->src_fd;
+	out_skip = offset;
+	out_left = length;
+	out_limit = (length > 0);
+
+	total = unpack_gz_members(PASS_STATE xstate);
+
+	free(bytebuffer);
+ ret:
+	free(window);
+	DEALLOC_STATE;
+	return total;
+}
+#endif
+
+#if ENABLE_FEATURE_GUNZIP_PARALLEL
+/* Multi-member .gz files (cat a.gz b.gz, or what backup tools write)
+ * can be inflated in parallel: members are independent.
+ *
+ * The file is cut into parts of about PAR_PART bytes. A part starts
+ * at the first thing after the cut which looks like a member header.
+ * We inflate the first part ourself, straight to the output; the next
+ * ones are inflated by forked workers, each into its own (unlinked)
+ * temp file. Whoever inflates a part goes on past its end until
+ * the member it is in is finished, and reports where that was.
+ * If this is where the next part starts, the next part started
+ * at a real member and its output is good. If it is past that,
+ * the next part's start was a false one (e.g. a stored .gz inside
+ * the data) and that part is discarded. If it is before that
+ * (the real member start was skipped together with a false one),
+ * we inflate the gap ourself. Parts which failed are also redone
+ * by us, so error messages are the same as without -p.
+ *
+ * A cut looks for a header only in the next PAR_SCAN_MAX bytes.
+ * If there is none, the cut is where the scan stopped, and no parts
+ * are started there: when the member we are in is done, we start
+ * over from its end. Thus a big single-member file is not read
+ * twice, only a bit of it is scanned.
+ */
+#define PAR_PART (1024 * 1024)
+#define PAR_SCAN_BUF (64 * 1024)
+#define PAR_SCAN_MAX (8 * PAR_PART)
+
+struct gz_part_result {
+	off_t end;
+	time_t mtime;
+	int ok;
+};
+
+struct gz_part {
+	pid_t pid;
+	int ctl_fd;
+	int out_fd;
+	off_t start;
+	off_t end;
+};
+
+static int is_gz_member(int fd, off_t pos)
+{
+	unsigned char magic[2];
+
+	return pread(fd, magic, 2, pos) == 2
+		&& magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+/* Offset of the first possible member header in the PAR_SCAN_MAX
+ * bytes from pos on. If there is none, where we stopped (or size) */
+static off_t find_gz_member(int fd, off_t pos, off_t size)
+{
+	unsigned char *buf = xmalloc(PAR_SCAN_BUF);
+	off_t limit = size;
+
+	if (size - pos > PAR_SCAN_MAX)
+		limit = pos + PAR_SCAN_MAX;
+	while (pos < limit) {
+		ssize_t len = pread(fd, buf, MIN(PAR_SCAN_BUF, limit + 3 - pos), pos);
+		unsigned char *p, *end;
+
+		if (len < 4)
+			break;
+		end = buf + len - 3;
+		/* magic, method 8 (deflate), reserved flag bits clear */
+		for (p = buf; (p = memchr(p, 0x1f, end - p)) != NULL; p++) {
+			if (p[1] == 0x8b && p[2] == 8 && !(p[3] & 0xe0)) {
+				pos += p - buf;
+				free(buf);
+				return pos;
+			}
+		}
+		pos += len - 3;
 	}
+	free(buf);
+	return limit;
+}
 
-	/* Validate decompression - crc */
-	v32 = buffer_read_le_u32(PASS_STATE_ONLY);
-	if ((~gunzip_crc) != v32) {
-		bb_error_msg("crc error");
-		total = -1;
-		goto ret;
+/* Inflate members from start on, stop after the one which ends
+ * at or past end. Store where it ended in *endp.
+ * If a member had incorrect length, *bad_lenp is set and the result
+ * counts from there on, as in unpack_gz_members: it is < 0 if that
+ * was the last member */
+static IF_DESKTOP(long long) int
+unpack_gz_part(transformer_state_t *xstate, off_t start, off_t end,
+		off_t *endp, int *bad_lenp)
+{
+	IF_DESKTOP(long long) int n = -1;
+	DECLARE_STATE;
+
+	ALLOC_STATE;
+	to_read = -1;
+	bytebuffer = xmalloc(bytebuffer_max);
+	gunzip_src_fd = xstate->src_fd;
+	src_pread = 1;
+	src_pos = start;
+	src_end = end;
+	bad_length = 0;
+	if (top_up(PASS_STATE 2)
+	 && bytebuffer[0] == 0x1f && bytebuffer[1] == 0x8b
+	) {
+		bytebuffer_offset = 2;
+		n = unpack_gz_members(PASS_STATE xstate);
 	}
+	*endp = src_pos - (bytebuffer_size - bytebuffer_offset);
+	*bad_lenp = bad_length;
+	free(bytebuffer);
+	DEALLOC_STATE;
+	return n;
+}
 
-	/* Validate decompression - size */
-	v32 = buffer_read_le_u32(PASS_STATE_ONLY);
-	if ((uint32_t)gunzip_bytes_out != v32) {
-		bb_error_msg("incorrect length");
-		total = -1;
+static void start_gz_part(transformer_state_t *xstate, struct gz_part *part,
+		off_t start, off_t end)
+{
+	const char *tmp_dir = getenv("TMPDIR");
+	char *name;
+	struct fd_pair fds;
+
+	if (!tmp_dir || !tmp_dir[0])
+		tmp_dir = "/tmp";
+	name = concat_path_file(tmp_dir, "gunzipXXXXXX");
+	part->out_fd = xmkstemp(name);
+	unlink(name);
+	free(name);
+	part->start = start;
+	part->end = end;
+	xpiped_pair(fds);
+	part->pid = xfork();
+	if (part->pid == 0) {
+		/* Worker */
+		struct gz_part_result res;
+		int bad_len;
+
+		close(fds.rd);
+		/* We may have started in the middle of a member,
+		 * and the parent redoes the parts which failed
+		 * (or had a member with incorrect length) */
+		logmode = LOGMODE_NONE;
+		xstate->dst_fd = part->out_fd;
+		res.ok = (unpack_gz_part(xstate, start, end, &res.end, &bad_len) >= 0
+				&& !bad_len);
+		res.mtime = xstate->mtime;
+		xwrite(fds.wr, &res, sizeof(res));
+		_exit(EXIT_SUCCESS);
 	}
+	close(fds.wr);
+	part->ctl_fd = fds.rd;
+}
 
-	if (!top_up(PASS_STATE 2))
-		goto ret; /* EOF */
+/* Add what a part gave to the total, as unpack_gz_members would.
+ * Returns 0 if it failed */
+static int add_gz_part(IF_DESKTOP(long long) int *total,
+		IF_DESKTOP(long long) int n, int bad_len)
+{
+	if (bad_len) {
+		/* The total started over at -1 there */
+		*total = n;
+		return 1;
+	}
+	if (n < 0)
+		return 0;
+	*total += n;
+	return 1;
+}
 
-	if (bytebuffer[bytebuffer_offset] == 0x1f
-	 && bytebuffer[bytebuffer_offset + 1] == 0x8b
+IF_DESKTOP(long long) int FAST_FUNC
+unpack_gz_stream_parallel(transformer_state_t *xstate, unsigned jobs)
+{
+	struct gz_part *part;
+	struct stat st;
+	IF_DESKTOP(long long) int total, n;
+	off_t pos, next, done;
+	unsigned head, busy;
+	int bad_len, failed;
+
+	if (jobs < 2
+	 || xstate->signature_skipped
+	 || xstate->mem_output_size_max
+	 || fstat(xstate->src_fd, &st) != 0
+	 || !S_ISREG(st.st_mode)
 	) {
-		bytebuffer_offset += 2;
-		goto again;
+		return unpack_gz_stream(xstate);
+	}
+	pos = lseek(xstate->src_fd, 0, SEEK_CUR);
+	if (pos < 0 || st.st_size - pos < 2 * PAR_PART
+	 || !is_gz_member(xstate->src_fd, pos)
+	) {
+		/* Small, or not gzip (.Z?): no need to bother */
+		return unpack_gz_stream(xstate);
 	}
-	/* GNU gzip says: */
-	/*bb_error_msg("decompression OK, trailing garbage ignored");*/
 
- ret:
-	free(bytebuffer);
-	DEALLOC_STATE;
-	return total;
+	part = xzalloc(jobs * sizeof(part[0]));
+	head = busy = 0;
+	total = 0;
+	failed = 0;
+	done = pos;
+	/* A new round when the scan gave up and all parts are in */
+	while (!failed && busy == 0
+	 && done < st.st_size && is_gz_member(xstate->src_fd, done)
+	) {
+		pos = done;
+		next = find_gz_member(xstate->src_fd, pos + PAR_PART, st.st_size);
+		done = next;
+		/* Workers start on the next parts while we do the first one */
+		while (busy < jobs - 1 && next < st.st_size
+		 && is_gz_member(xstate->src_fd, next)
+		) {
+			off_t start = next;
+
+			next = find_gz_member(xstate->src_fd, start + PAR_PART, st.st_size);
+			start_gz_part(xstate, &part[(head + busy) % jobs], start, next);
+			busy++;
+		}
+		n = unpack_gz_part(xstate, pos, done, &done, &bad_len);
+		failed = !add_gz_part(&total, n, bad_len);
+
+		while (!failed) {
+			struct gz_part *p;
+			struct gz_part_result res;
+
+			/* Keep all workers busy */
+			while (busy < jobs && next < st.st_size
+			 && is_gz_member(xstate->src_fd, next)
+			) {
+				off_t start = next;
+
+				next = find_gz_member(xstate->src_fd, start + PAR_PART, st.st_size);
+				start_gz_part(xstate, &part[(head + busy) % jobs], start, next);
+				busy++;
+			}
+			if (busy == 0)
+				break;
+
+			p = &part[head];
+			head = (head + 1) % jobs;
+			busy--;
+			if (full_read(p->ctl_fd, &res, sizeof(res)) != sizeof(res))
+				res.ok = 0;
+			close(p->ctl_fd);
+			wait4pid(p->pid);
+
+			if (done < p->start) {
+				/* Inflate the gap before this part */
+				if (!is_gz_member(xstate->src_fd, done)) {
+					/* Trailing garbage is ignored */
+					close(p->out_fd);
+					break;
+				}
+				n = unpack_gz_part(xstate, done, p->start, &done, &bad_len);
+				failed = !add_gz_part(&total, n, bad_len);
+			}
+			if (!failed && done == p->start) {
+				bad_len = 0;
+				if (res.ok) {
+					off_t copied;
+
+					xlseek(p->out_fd, 0, SEEK_SET);
+					copied = bb_copyfd_eof(p->out_fd, xstate->dst_fd);
+					n = (copied < 0) ? -1 : 0;
+					IF_DESKTOP(if (copied > 0) n = copied;)
+					done = res.end;
+					xstate->mtime = res.mtime;
+				} else {
+					/* Redo it for the error message. Or maybe
+					 * it was the temp file which failed */
+					n = unpack_gz_part(xstate, p->start, p->end, &done, &bad_len);
+				}
+				failed = !add_gz_part(&total, n, bad_len);
+			}
+			/* else done > p->start: this part started at a false member,
+			 * or done < p->start: trailing garbage after the gap */
+			close(p->out_fd);
+			if (done < p->start)
+				break;
+		}
+	}
+
+	/* Stop workers we no longer need */
+	while (busy != 0) {
+		struct gz_part *p = &part[head];
+
+		kill(p->pid, SIGKILL);
+		wait4pid(p->pid);
+		close(p->ctl_fd);
+		close(p->out_fd);
+		head = (head + 1) % jobs;
+		busy--;
+	}
+	free(part);
+	return failed ? -1 : total;
 }
+#endif
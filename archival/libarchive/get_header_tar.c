@@ -147,6 +147,63 @@ static void process_pax_hdr(archive_handle_t *archive_handle, unsigned sz, int g
 #endif
 }
 
+#if ENABLE_FEATURE_TAR_SPARSE
+/* Append used entries of sp[n] to the sparse map.
+ * NB: trashes the byte after sp[n - 1] */
+static unsigned add_sparse_entries(file_header_t *file_header, unsigned cnt,
+		tar_sparse_entry_t *sp, unsigned n)
+{
+	unsigned used = 0;
+
+	while (used < n && sp[used].offset[0])
+		used++;
+	file_header->tar__sparse = xrealloc(file_header->tar__sparse,
+			(cnt + used) * sizeof(file_header->tar__sparse[0]));
+	/* getOctal trashes the next field: go backwards */
+	n = used;
+	while (n--) {
+		file_header->tar__sparse[cnt + n].numbytes = GET_OCTAL(sp[n].numbytes);
+		file_header->tar__sparse[cnt + n].offset = GET_OCTAL(sp[n].offset);
+	}
+	return cnt + used;
+}
+
+/* Read the map of a GNU sparse member, check that it is sane */
+static void get_sparse_map(archive_handle_t *archive_handle, tar_sparse_header_t *sh)
+{
+	file_header_t *file_header = archive_handle->file_header;
+	tar_sparse_ext_t ext;
+	char isextended;
+	unsigned cnt, i;
+	off_t pos, total;
+
+	isextended = sh->isextended;
+	file_header->tar__realsize = GET_OCTAL(sh->realsize);
+	cnt = add_sparse_entries(file_header, 0, sh->sp, ARRAY_SIZE(sh->sp));
+	while (isextended) {
+		xread(archive_handle->src_fd, &ext, sizeof(ext));
+		archive_handle->offset += sizeof(ext);
+		isextended = ext.isextended;
+		cnt = add_sparse_entries(file_header, cnt, ext.sp, ARRAY_SIZE(ext.sp));
+	}
+	file_header->tar__sparse_cnt = cnt;
+
+	pos = total = 0;
+	for (i = 0; i < cnt; i++) {
+		sparse_extent_t *e = &file_header->tar__sparse[i];
+		if (e->offset < pos || e->numbytes < 0
+		 || e->offset + e->numbytes > file_header->tar__realsize
+		) {
+			break;
+		}
+		pos = e->offset + e->numbytes;
+		total += e->numbytes;
+	}
+	if (i != cnt || total != file_header->size)
+		bb_error_msg_and_die("corrupted sparse map");
+}
+#endif
+
 char FAST_FUNC get_header_tar(archive_handle_t *archive_handle)
 {
 	file_header_t *file_header = archive_handle->file_header;
@@ -288,6 +345,13 @@ char FAST_FUNC get_header_tar(archive_handle_t *archive_handle)
 	/* 0 is reserved for high perf file, treat as normal file */
 	if (!tar.typeflag) tar.typeflag = '0';
 	parse_names = (tar.typeflag >= '0' && tar.typeflag <= '7');
+#if ENABLE_FEATURE_TAR_SPARSE
+	/* GNU sparse file has its map where prefix would be */
+	if (tar.typeflag == 'S') {
+		parse_names = 1;
+		tar.prefix[0] = '\0';
+	}
+#endif
 
 	/* getOctal trashes subsequent field, therefore we call it
 	 * on fields in reverse order */
@@ -300,6 +364,9 @@ char FAST_FUNC get_header_tar(archive_handle_t *archive_handle)
 		tar.prefix[0] = t;
 	}
 	file_header->link_target = NULL;
+#if ENABLE_FEATURE_TAR_SPARSE
+	file_header->tar__sparse = NULL;
+#endif
 	if (!p_linkname && parse_names && tar.linkname[0]) {
 		file_header->link_target = xstrndup(tar.linkname, sizeof(tar.linkname));
 		/* FIXME: what if we have non-link object with link_target? */
@@ -404,12 +471,14 @@ char FAST_FUNC get_header_tar(archive_handle_t *archive_handle)
 		archive_handle->offset += file_header->size;
 		/* return get_header_tar(archive_handle); */
 		goto again;
-/*
- *	case 'S':	// Sparse file
- * Was seen in the wild. Not supported (yet?).
- * See https://www.gnu.org/software/tar/manual/html_section/tar_92.html
- * for the format. (An "Old GNU Format" was seen, not PAX formats).
- */
+# if ENABLE_FEATURE_TAR_SPARSE
+	/* See https://www.gnu.org/software/tar/manual/html_section/tar_92.html
+	 * for the format. We support "Old GNU Format", not PAX formats */
+	case 'S':	/* GNU sparse file */
+		get_sparse_map(archive_handle, (tar_sparse_header_t *)tar.prefix);
+		file_header->mode |= S_IFREG;
+		break;
+# endif
 //	case 'D':	/* GNU dump dir */
 //	case 'M':	/* Continuation of multi volume archive */
 //	case 'N':	/* Old GNU for names > 100 characters */
@@ -476,6 +545,9 @@ char FAST_FUNC get_header_tar(archive_handle_t *archive_handle)
 #if ENABLE_FEATURE_TAR_UNAME_GNAME
 	free(file_header->tar__uname);
 	free(file_header->tar__gname);
+#endif
+#if ENABLE_FEATURE_TAR_SPARSE
+	free(file_header->tar__sparse);
 #endif
 	return EXIT_SUCCESS; /* "decoded one header" */
 }
@@ -6,11 +6,63 @@
 #include "libbb.h"
 #include "bb_archive.h"
 
+enum {
+	SKIP_BUFSIZE = 64 * 1024,      /* the usual pipe capacity */
+	SKIP_SPLICE_MAX = 1024 * 1024 * 1024,
+};
+
+static void skip_failed(ssize_t n) NORETURN;
+static void skip_failed(ssize_t n)
+{
+	if (n < 0)
+		bb_perror_msg_and_die(bb_msg_read_error);
+	bb_error_msg_and_die("short read");
+}
+
 /*  If we are reading through a pipe, or from stdin then we can't lseek,
  *  we must read and discard the data to skip over it.
+ *  Out of a pipe, splice() to /dev/null discards it without copying.
  */
 void FAST_FUNC seek_by_read(int fd, off_t amount)
 {
-	if (amount)
-		bb_copyfd_exact_size(fd, -1, amount);
+#if ENABLE_FEATURE_USE_SPLICE
+	static int null_fd = -2; /* not opened yet; -1: splice doesn't work */
+#endif
+	static char *skip_buf;
+
+	if (!amount)
+		return;
+
+#if ENABLE_FEATURE_USE_SPLICE
+	if (null_fd == -2)
+		null_fd = open(bb_dev_null, O_WRONLY | O_CLOEXEC);
+	while (null_fd >= 0) {
+		ssize_t n = splice(fd, NULL, null_fd, NULL,
+				amount > SKIP_SPLICE_MAX ? SKIP_SPLICE_MAX : amount, 0);
+		if (n > 0) {
+			amount -= n;
+			if (!amount)
+				return;
+			continue;
+		}
+		if (n == 0)
+			skip_failed(0);
+		if (errno == EINTR)
+			continue;
+		/* Not a pipe (socket, tape...): use read().
+		 * If it was a read error, read() will see it too */
+		close(null_fd);
+		null_fd = -1;
+	}
+#endif
+
+	if (!skip_buf)
+		skip_buf = xmalloc(SKIP_BUFSIZE);
+	do {
+		ssize_t n = safe_read(fd, skip_buf,
+				amount > SKIP_BUFSIZE ? SKIP_BUFSIZE : amount);
+		if (n <= 0)
+			skip_failed(n);
+		amount -= n;
+	} while (amount);
 }
@@ -100,6 +100,15 @@
 //config:	  With this option busybox supports GNU long filenames and
 //config:	  linknames.
 //config:
+//config:config FEATURE_TAR_SPARSE
+//config:	bool "Support for sparse files"
+//config:	default y
+//config:	depends on FEATURE_TAR_GNU_EXTENSIONS
+//config:	help
+//config:	  With this option busybox extracts GNU sparse files
+//config:	  (old GNU format) with holes, and supports -S option
+//config:	  to create them: only data of files with holes is stored.
+//config:
 //config:config FEATURE_TAR_LONG_OPTIONS
 //config:	bool "Enable long options"
 //config:	default y
@@ -140,6 +149,17 @@
 //config:	help
 //config:	  With this option busybox supports restoring SELinux labels
 //config:	  when extracting files from tar archives.
+//config:
+//config:config FEATURE_TAR_JOBS
+//config:	bool "Enable --jobs N (extract using N processes)"
+//config:	default y
+//config:	depends on FEATURE_TAR_LONG_OPTIONS && !NOMMU && PLATFORM_POSIX
+//config:	help
+//config:	  With tar -x --jobs N, small regular files are created
+//config:	  and written by N processes while tar reads the archive.
+//config:	  This makes extracting trees of many small files faster
+//config:	  when creating a file takes long (network filesystems,
+//config:	  slow disks, fsync-heavy filesystems).
 
 //applet:IF_TAR(APPLET(tar, BB_DIR_BIN, BB_SUID_DROP))
 //kbuild:lib-$(CONFIG_TAR) += tar.o
@@ -167,27 +187,21 @@
 
 #if ENABLE_FEATURE_TAR_CREATE
 
-/*
-** writeTarFile(), writeFileToTarball(), and writeTarHeader() are
-** the only functions that deal with the HardLinkInfo structure.
-** Even these functions use the xxxHardLinkInfo() functions.
-*/
-typedef struct HardLinkInfo {
-	struct HardLinkInfo *next; /* Next entry in list */
-	dev_t dev;                 /* Device number */
-	ino_t ino;                 /* Inode number */
-//	short linkCount;           /* (Hard) Link Count */
-	char name[1];              /* Start of filename (must be last) */
-} HardLinkInfo;
-
 /* Some info to be carried along when creating a new tarball */
 typedef struct TarBallInfo {
 	int tarFd;                      /* Open-for-write file descriptor
 	                                 * for the tarball */
 	int verboseFlag;                /* Whether to print extra stuff or not */
 	const llist_t *excludeList;     /* List of files to not include */
-	HardLinkInfo *hlInfoHead;       /* Hard Link Tracking Information */
-	HardLinkInfo *hlInfo;           /* Hard Link Info for the current file */
+	ino_dev_table_t *hlTable;       /* Hard links: dev/ino -> first name */
+	const char *hlName;             /* Link target if the current file
+	                                 * is a hard link */
+#if ENABLE_FEATURE_TAR_SPARSE
+	smallint sparse;                /* -S */
+	unsigned sparseCnt;             /* Data extents of the current file, */
+	sparse_extent_t *sparseMap;     /* if it is stored as sparse */
+	off_t sparseSize;               /* Sum of their sizes */
+#endif
 //TODO: save only st_dev + st_ino
 	struct stat tarFileStatBuf;     /* Stat info for the tarball, letting
 	                                 * us know the inode and device that the
@@ -208,55 +222,14 @@ enum {
 	CONTTYPE = '7',		/* reserved */
 	GNULONGLINK = 'K',	/* GNU long (>100 chars) link name */
 	GNULONGNAME = 'L',	/* GNU long (>100 chars) file name */
+	GNUSPARSE = 'S',	/* GNU sparse file */
 };
 
-/* Might be faster (and bigger) if the dev/ino were stored in numeric order;) */
-static void addHardLinkInfo(HardLinkInfo **hlInfoHeadPtr,
-					struct stat *statbuf,
-					const char *fileName)
+static void FAST_FUNC free_name(void *name)
 {
-	/* Note: hlInfoHeadPtr can never be NULL! */
-	HardLinkInfo *hlInfo;
-
-	hlInfo = xmalloc(sizeof(HardLinkInfo) + strlen(fileName));
-	hlInfo->next = *hlInfoHeadPtr;
-	*hlInfoHeadPtr = hlInfo;
-	hlInfo->dev = statbuf->st_dev;
-	hlInfo->ino = statbuf->st_ino;
-//	hlInfo->linkCount = statbuf->st_nlink;
-	strcpy(hlInfo->name, fileName);
+	free(name);
 }
 
-static void freeHardLinkInfo(HardLinkInfo **hlInfoHeadPtr)
-{
-	HardLinkInfo *hlInfo;
-	HardLinkInfo *hlInfoNext;
-
-	if (hlInfoHeadPtr) {
-		hlInfo = *hlInfoHeadPtr;
-		while (hlInfo) {
-			hlInfoNext = hlInfo->next;
-			free(hlInfo);
-			hlInfo = hlInfoNext;
-		}
-		*hlInfoHeadPtr = NULL;
-	}
-}
-
-/* Might be faster (and bigger) if the dev/ino were stored in numeric order ;) */
-static HardLinkInfo *findHardLinkInfo(HardLinkInfo *hlInfo, struct stat *statbuf)
-{
-	while (hlInfo) {
-		if (statbuf->st_ino == hlInfo->ino
-		 && statbuf->st_dev == hlInfo->dev
-		) {
-			DBG("found hardlink:'%s'", hlInfo->name);
-			break;
-		}
-		hlInfo = hlInfo->next;
-	}
-	return hlInfo;
-}
 
 /* Put an octal string into the specified buffer.
  * The number is zero padded and possibly null terminated.
@@ -281,6 +254,44 @@ static void putOctal(char *cp, int len, off_t value)
 }
 #define PUT_OCTAL(a, b) putOctal((a), sizeof(a), (b))
 
+/* Put a size or an offset into a 12-byte field.
+ * Returns 0 if it does not fit. */
+static int putSize(char *cp, uoff_t value)
+{
+	/* Does octal-encoded size fit? */
+	if (sizeof(value) <= 4
+	 || value <= (uoff_t)0777777777777LL
+	) {
+		putOctal(cp, 12, value);
+		return 1;
+	}
+	/* Does base256-encoded size fit?
+	 * It always does unless off_t is wider than 64 bits.
+	 */
+	if (ENABLE_FEATURE_TAR_GNU_EXTENSIONS
+#if ULLONG_MAX > 0xffffffffffffffffLL /* 2^64-1 */
+	 && (value <= 0x3fffffffffffffffffffffffLL)
+#endif
+	) {
+		/* GNU tar uses "base-256 encoding" for very large numbers.
+		 * Encoding is binary, with highest bit always set as a marker
+		 * and sign in next-highest bit:
+		 * 80 00 .. 00 - zero
+		 * bf ff .. ff - largest positive number
+		 * ff ff .. ff - minus 1
+		 * c0 00 .. 00 - smallest negative number
+		 */
+		char *p8 = cp + 12;
+		do {
+			*--p8 = (uint8_t)value;
+			value >>= 8;
+		} while (p8 != cp);
+		*p8 |= 0x80;
+		return 1;
+	}
+	return 0;
+}
+
 static void chksum_and_xwrite(int fd, struct tar_header_t* hp)
 {
 	/* POSIX says that checksum is done on unsigned bytes
@@ -371,16 +382,16 @@ static int writeTarHeader(struct TarBallInfo *tbInfo,
 	safe_strncpy(header.uname, get_cached_username(statbuf->st_uid), sizeof(header.uname));
 	safe_strncpy(header.gname, get_cached_groupname(statbuf->st_gid), sizeof(header.gname));
 
-	if (tbInfo->hlInfo) {
+	if (tbInfo->hlName) {
 		/* This is a hard link */
 		header.typeflag = LNKTYPE;
-		strncpy(header.linkname, tbInfo->hlInfo->name,
+		strncpy(header.linkname, tbInfo->hlName,
 				sizeof(header.linkname));
 #if ENABLE_FEATURE_TAR_GNU_EXTENSIONS
 		/* Write out long linkname if needed */
 		if (header.linkname[sizeof(header.linkname)-1])
 			writeLongname(tbInfo->tarFd, GNULONGLINK,
-					tbInfo->hlInfo->name, 0);
+					tbInfo->hlName, 0);
 #endif
 	} else if (S_ISLNK(statbuf->st_mode)) {
 		char *lpath = xmalloc_readlink_or_warn(fileName);
@@ -418,41 +429,28 @@ static int writeTarHeader(struct TarBallInfo *tbInfo,
 		header.typeflag = FIFOTYPE;
 	} else if (S_ISREG(statbuf->st_mode)) {
 		/* header.size field is 12 bytes long */
-		/* Does octal-encoded size fit? */
-		uoff_t filesize = statbuf->st_size;
-		if (sizeof(filesize) <= 4
-		 || filesize <= (uoff_t)0777777777777LL
-		) {
-			PUT_OCTAL(header.size, filesize);
-		}
-		/* Does base256-encoded size fit?
-		 * It always does unless off_t is wider than 64 bits.
-		 */
-		else if (ENABLE_FEATURE_TAR_GNU_EXTENSIONS
-#if ULLONG_MAX > 0xffffffffffffffffLL /* 2^64-1 */
-		 && (filesize <= 0x3fffffffffffffffffffffffLL)
-#endif
-		) {
-			/* GNU tar uses "base-256 encoding" for very large numbers.
-			 * Encoding is binary, with highest bit always set as a marker
-			 * and sign in next-highest bit:
-			 * 80 00 .. 00 - zero
-			 * bf ff .. ff - largest positive number
-			 * ff ff .. ff - minus 1
-			 * c0 00 .. 00 - smallest negative number
-			 */
-			char *p8 = header.size + sizeof(header.size);
-			do {
-				*--p8 = (uint8_t)filesize;
-				filesize >>= 8;
-			} while (p8 != header.size);
-			*p8 |= 0x80;
-		} else {
+		if (!putSize(header.size, statbuf->st_size)) {
 			bb_error_msg_and_die("can't store file '%s' "
 				"of size %"OFF_FMT"u, aborting",
 				fileName, statbuf->st_size);
 		}
 		header.typeflag = REGTYPE;
+#if ENABLE_FEATURE_TAR_SPARSE
+		if (tbInfo->sparseMap) {
+			tar_sparse_header_t *sh = (void*)header.prefix;
+			unsigned i;
+
+			/* Only data extents are stored */
+			putSize(header.size, tbInfo->sparseSize);
+			putSize(sh->realsize, statbuf->st_size);
+			for (i = 0; i < tbInfo->sparseCnt && i < ARRAY_SIZE(sh->sp); i++) {
+				putSize(sh->sp[i].offset, tbInfo->sparseMap[i].offset);
+				putSize(sh->sp[i].numbytes, tbInfo->sparseMap[i].numbytes);
+			}
+			sh->isextended = (i < tbInfo->sparseCnt);
+			header.typeflag = GNUSPARSE;
+		}
+#endif
 	} else {
 		bb_error_msg("%s: unknown file type", fileName);
 		return FALSE;
@@ -469,6 +467,25 @@ static int writeTarHeader(struct TarBallInfo *tbInfo,
 	/* Now write the header out to disk */
 	chksum_and_xwrite(tbInfo->tarFd, &header);
 
+#if ENABLE_FEATURE_TAR_SPARSE
+	/* The rest of sparse map goes into blocks after header */
+	if (header.typeflag == GNUSPARSE) {
+		unsigned i = ARRAY_SIZE(((tar_sparse_header_t *)0)->sp);
+		while (i < tbInfo->sparseCnt) {
+			tar_sparse_ext_t ext;
+			unsigned j;
+
+			memset(&ext, 0, sizeof(ext));
+			for (j = 0; i < tbInfo->sparseCnt && j < ARRAY_SIZE(ext.sp); i++, j++) {
+				putSize(ext.sp[j].offset, tbInfo->sparseMap[i].offset);
+				putSize(ext.sp[j].numbytes, tbInfo->sparseMap[i].numbytes);
+			}
+			ext.isextended = (i < tbInfo->sparseCnt);
+			xwrite(tbInfo->tarFd, &ext, sizeof(ext));
+		}
+	}
+#endif
+
 	/* Now do the verbose thing (or not) */
 	if (tbInfo->verboseFlag) {
 		FILE *vbFd = stdout;
@@ -516,6 +533,62 @@ static int exclude_file(const llist_t *excluded_files, const char *file)
 # define exclude_file(excluded_files, file) 0
 #endif
 
+#if ENABLE_FEATURE_TAR_SPARSE
+/* Find data extents of a file with holes. The map ends with
+ * an empty extent at EOF if the file ends in a hole (GNU tar does this).
+ * Returns 0 if the file is not sparse or we can't tell */
+static int getSparseMap(struct TarBallInfo *tbInfo, int fd, const struct stat *statbuf)
+{
+# if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	off_t size = statbuf->st_size;
+	off_t pos = 0;
+	unsigned cnt = 0;
+	sparse_extent_t *map = NULL;
+
+	/* Fewer blocks than size needs? */
+	if ((off_t)statbuf->st_blocks * 512 >= size)
+		return 0;
+	tbInfo->sparseSize = 0;
+	while (pos < size) {
+		off_t data, hole;
+
+		data = lseek(fd, pos, SEEK_DATA);
+		if (data < 0) {
+			if (errno != ENXIO) /* ENXIO: no data after pos */
+				goto fail;
+			break;
+		}
+		if (data >= size)
+			break;
+		hole = lseek(fd, data, SEEK_HOLE);
+		if (hole < 0)
+			goto fail;
+		if (hole > size)
+			hole = size;
+		map = xrealloc_vector(map, 4, cnt);
+		map[cnt].offset = data;
+		map[cnt].numbytes = hole - data;
+		tbInfo->sparseSize += hole - data;
+		cnt++;
+		pos = hole;
+	}
+	if (pos < size) {
+		map = xrealloc_vector(map, 4, cnt);
+		map[cnt].offset = size;
+		map[cnt].numbytes = 0;
+		cnt++;
+	}
+	tbInfo->sparseMap = map;
+	tbInfo->sparseCnt = cnt;
+	return 1;
+ fail:
+	free(map);
+	xlseek(fd, 0, SEEK_SET);
+# endif
+	return 0;
+}
+#endif
+
 static int FAST_FUNC writeFileToTarball(const char *fileName, struct stat *statbuf,
 			void *userData, int depth UNUSED_PARAM)
 {
@@ -542,15 +615,19 @@ static int FAST_FUNC writeFileToTarball(const char *fileName, struct stat *statb
 	 * If so -
 	 * Treat the first occurance of a given dev/inode as a file while
 	 * treating any additional occurances as hard links.  This is done
-	 * by adding the file information to the HardLinkInfo linked list.
+	 * by adding the file information to the hard link table.
 	 */
-	tbInfo->hlInfo = NULL;
+	tbInfo->hlName = NULL;
 	if (!S_ISDIR(statbuf->st_mode) && statbuf->st_nlink > 1) {
+		void **name;
+
 		DBG("'%s': st_nlink > 1", header_name);
-		tbInfo->hlInfo = findHardLinkInfo(tbInfo->hlInfoHead, statbuf);
-		if (tbInfo->hlInfo == NULL) {
-			DBG("'%s': addHardLinkInfo", header_name);
-			addHardLinkInfo(&tbInfo->hlInfoHead, statbuf, header_name);
+		name = ino_dev_table_add(&tbInfo->hlTable, statbuf);
+		if (*name) {
+			tbInfo->hlName = *name;
+			DBG("found hardlink:'%s'", tbInfo->hlName);
+		} else {
+			*name = xstrdup(header_name);
 		}
 	}
 
@@ -577,12 +654,16 @@ static int FAST_FUNC writeFileToTarball(const char *fileName, struct stat *statb
 #endif
 
 	/* Is this a regular file? */
-	if (tbInfo->hlInfo == NULL && S_ISREG(statbuf->st_mode)) {
+	if (tbInfo->hlName == NULL && S_ISREG(statbuf->st_mode)) {
 		/* open the file we want to archive, and make sure all is well */
 		inputFileFd = open_or_warn(fileName, O_RDONLY);
 		if (inputFileFd < 0) {
 			return FALSE;
 		}
+#if ENABLE_FEATURE_TAR_SPARSE
+		if (tbInfo->sparse)
+			getSparseMap(tbInfo, inputFileFd, statbuf);
+#endif
 	}
 
 	/* Add an entry to the tarball */
@@ -593,12 +674,27 @@ static int FAST_FUNC writeFileToTarball(const char *fileName, struct stat *statb
 	/* If it was a regular file, write out the body */
 	if (inputFileFd >= 0) {
 		size_t readSize;
+		off_t storedSize = statbuf->st_size;
 		/* Write the file to the archive. */
 		/* We record size into header first, */
 		/* and then write out file. If file shrinks in between, */
 		/* tar will be corrupted. So we don't allow for that. */
 		/* NB: GNU tar 1.16 warns and pads with zeroes */
 		/* or even seeks back and updates header */
+#if ENABLE_FEATURE_TAR_SPARSE
+		if (tbInfo->sparseMap) {
+			unsigned i;
+
+			for (i = 0; i < tbInfo->sparseCnt; i++) {
+				xlseek(inputFileFd, tbInfo->sparseMap[i].offset, SEEK_SET);
+				bb_copyfd_exact_size(inputFileFd, tbInfo->tarFd,
+						tbInfo->sparseMap[i].numbytes);
+			}
+			storedSize = tbInfo->sparseSize;
+			free(tbInfo->sparseMap);
+			tbInfo->sparseMap = NULL;
+		} else
+#endif
 		bb_copyfd_exact_size(inputFileFd, tbInfo->tarFd, statbuf->st_size);
 		////off_t readSize;
 		////readSize = bb_copyfd_size(inputFileFd, tbInfo->tarFd, statbuf->st_size);
@@ -613,7 +709,7 @@ static int FAST_FUNC writeFileToTarball(const char *fileName, struct stat *statb
 
 		/* Pad the file up to the tar block size */
 		/* (a few tricks here in the name of code size) */
-		readSize = (-(int)statbuf->st_size) & (TAR_BLOCK_SIZE-1);
+		readSize = (-(int)storedSize) & (TAR_BLOCK_SIZE-1);
 		memset(block_buf, 0, readSize);
 		xwrite(tbInfo->tarFd, block_buf, readSize);
 	}
@@ -708,11 +804,12 @@ static pid_t vfork_compressor(int tar_fd, const char *gzip)
 
 #if !SEAMLESS_COMPRESSION
 /* Do not pass gzip flag to writeTarFile() */
-#define writeTarFile(tar_fd, verboseFlag, recurseFlags, include, exclude, gzip) \
-	writeTarFile(tar_fd, verboseFlag, recurseFlags, include, exclude)
+#define writeTarFile(tar_fd, verboseFlag, sparseFlag, recurseFlags, include, exclude, gzip) \
+	writeTarFile(tar_fd, verboseFlag, sparseFlag, recurseFlags, include, exclude)
 #endif
 /* gcc 4.2.1 inlines it, making code bigger */
 static NOINLINE int writeTarFile(int tar_fd, int verboseFlag,
+	int sparseFlag UNUSED_PARAM,
 	int recurseFlags, const llist_t *include,
 	const llist_t *exclude, const char *gzip)
 {
@@ -720,9 +817,13 @@ static NOINLINE int writeTarFile(int tar_fd, int verboseFlag,
 	struct TarBallInfo tbInfo;
 	IF_PLATFORM_MINGW32(pid_t pid = 0;)
 
-	tbInfo.hlInfoHead = NULL;
+	tbInfo.hlTable = NULL;
 	tbInfo.tarFd = tar_fd;
 	tbInfo.verboseFlag = verboseFlag;
+#if ENABLE_FEATURE_TAR_SPARSE
+	tbInfo.sparse = sparseFlag;
+	tbInfo.sparseMap = NULL;
+#endif
 
 	/* Store the stat info for the tarball's file, so
 	 * can avoid including the tarball into itself....  */
@@ -758,7 +859,7 @@ static NOINLINE int writeTarFile(int tar_fd, int verboseFlag,
 
 	/* Hang up the tools, close up shop, head home */
 	if (ENABLE_FEATURE_CLEAN_UP)
-		freeHardLinkInfo(&tbInfo.hlInfoHead);
+		ino_dev_table_free(tbInfo.hlTable, free_name);
 
 	if (errorFlag)
 		bb_error_msg("error exit delayed from previous errors");
@@ -814,6 +915,7 @@ static llist_t *append_file_list_to_list(llist_t *list)
 //usage:	IF_FEATURE_SEAMLESS_LZMA("a")
 //usage:	IF_FEATURE_TAR_CREATE("h")
 //usage:	IF_FEATURE_TAR_NOPRESERVE_TIME("m")
+//usage:	IF_FEATURE_TAR_SPARSE("S")
 //usage:	"vO] "
 //usage:	IF_FEATURE_TAR_FROM("[-X FILE] [-T FILE] ")
 //usage:	"[-f TARFILE] [-C DIR] [FILE]..."
@@ -852,10 +954,16 @@ static llist_t *append_file_list_to_list(llist_t *list)
 //usage:	IF_FEATURE_TAR_NOPRESERVE_TIME(
 //usage:     "\n	m	Don't restore mtime"
 //usage:	)
+//usage:	IF_FEATURE_TAR_SPARSE(
+//usage:     "\n	S	Store only data of files with holes"
+//usage:	)
 //usage:	IF_FEATURE_TAR_FROM(
 //usage:	IF_FEATURE_TAR_LONG_OPTIONS(
 //usage:     "\n	exclude	File to exclude"
 //usage:	)
+//usage:	IF_FEATURE_TAR_JOBS(
+//usage:     "\n	jobs N	Extract using N processes"
+//usage:	)
 //usage:     "\n	X	File with names to exclude"
 //usage:     "\n	T	File with names to include"
 //usage:	)
@@ -888,8 +996,10 @@ enum {
 	IF_FEATURE_SEAMLESS_XZ(  OPTBIT_XZ          ,) // 16th bit
 	IF_FEATURE_SEAMLESS_Z(   OPTBIT_COMPRESS    ,)
 	IF_FEATURE_TAR_NOPRESERVE_TIME(OPTBIT_NOPRESERVE_TIME,)
+	IF_FEATURE_TAR_SPARSE(   OPTBIT_SPARSE      ,)
 #if ENABLE_FEATURE_TAR_LONG_OPTIONS
 	OPTBIT_STRIP_COMPONENTS,
+	IF_FEATURE_TAR_JOBS(OPTBIT_JOBS,)
 	OPTBIT_NORECURSION,
 	IF_FEATURE_TAR_TO_COMMAND(OPTBIT_2COMMAND   ,)
 	OPTBIT_NUMERIC_OWNER,
@@ -915,7 +1025,9 @@ enum {
 	OPT_XZ           = IF_FEATURE_SEAMLESS_XZ(  (1 << OPTBIT_XZ          )) + 0, // J
 	OPT_COMPRESS     = IF_FEATURE_SEAMLESS_Z(   (1 << OPTBIT_COMPRESS    )) + 0, // Z
 	OPT_NOPRESERVE_TIME  = IF_FEATURE_TAR_NOPRESERVE_TIME((1 << OPTBIT_NOPRESERVE_TIME)) + 0, // m
+	OPT_SPARSE           = IF_FEATURE_TAR_SPARSE(   (1 << OPTBIT_SPARSE      )) + 0, // S
 	OPT_STRIP_COMPONENTS = IF_FEATURE_TAR_LONG_OPTIONS((1 << OPTBIT_STRIP_COMPONENTS)) + 0, // strip-components
+	OPT_JOBS             = IF_FEATURE_TAR_JOBS(        (1 << OPTBIT_JOBS           )) + 0, // jobs
 	OPT_NORECURSION      = IF_FEATURE_TAR_LONG_OPTIONS((1 << OPTBIT_NORECURSION    )) + 0, // no-recursion
 	OPT_2COMMAND         = IF_FEATURE_TAR_TO_COMMAND(  (1 << OPTBIT_2COMMAND       )) + 0, // to-command
 	OPT_NUMERIC_OWNER    = IF_FEATURE_TAR_LONG_OPTIONS((1 << OPTBIT_NUMERIC_OWNER  )) + 0, // numeric-owner
@@ -963,8 +1075,14 @@ static const char tar_longopts[] ALIGN1 =
 # endif
 # if ENABLE_FEATURE_TAR_NOPRESERVE_TIME
 	"touch\0"               No_argument       "m"
+# endif
+# if ENABLE_FEATURE_TAR_SPARSE
+	"sparse\0"              No_argument       "S"
 # endif
 	"strip-components\0"	Required_argument "\xf9"
+# if ENABLE_FEATURE_TAR_JOBS
+	"jobs\0"		Required_argument "\xf8"
+# endif
 	"no-recursion\0"	No_argument       "\xfa"
 # if ENABLE_FEATURE_TAR_TO_COMMAND
 	"to-command\0"		Required_argument "\xfb"
@@ -991,6 +1109,7 @@ int tar_main(int argc UNUSED_PARAM, char **argv)
 	const char *tar_filename = "-";
 	unsigned opt;
 	int verboseFlag = 0;
+	IF_FEATURE_TAR_JOBS(unsigned jobs = 0;)
 #if ENABLE_FEATURE_TAR_LONG_OPTIONS && ENABLE_FEATURE_TAR_FROM
 	llist_t *excludes = NULL;
 #endif
@@ -1018,6 +1137,7 @@ int tar_main(int argc UNUSED_PARAM, char **argv)
 #if ENABLE_FEATURE_TAR_LONG_OPTIONS
 		":\xf9+" // --strip-components=NUM
 #endif
+		IF_FEATURE_TAR_JOBS(":\xf8+") // --jobs=NUM
 	;
 #if ENABLE_FEATURE_TAR_LONG_OPTIONS
 	applet_long_options = tar_longopts;
@@ -1068,7 +1188,9 @@ int tar_main(int argc UNUSED_PARAM, char **argv)
 		IF_FEATURE_SEAMLESS_XZ(  "J"     )
 		IF_FEATURE_SEAMLESS_Z(   "Z"     )
 		IF_FEATURE_TAR_NOPRESERVE_TIME("m")
+		IF_FEATURE_TAR_SPARSE(   "S"     )
 		IF_FEATURE_TAR_LONG_OPTIONS("\xf9:") // --strip-components
+		IF_FEATURE_TAR_JOBS("\xf8:") // --jobs
 		, &base_dir // -C dir
 		, &tar_filename // -f filename
 		IF_FEATURE_TAR_FROM(, &(tar_handle->accept)) // T
@@ -1076,6 +1198,7 @@ int tar_main(int argc UNUSED_PARAM, char **argv)
 #if ENABLE_FEATURE_TAR_LONG_OPTIONS
 		, &tar_handle->tar__strip_components // --strip-components
 #endif
+		IF_FEATURE_TAR_JOBS(, &jobs) // --jobs
 		IF_FEATURE_TAR_TO_COMMAND(, &(tar_handle->tar__to_command)) // --to-command
 #if ENABLE_FEATURE_TAR_LONG_OPTIONS && ENABLE_FEATURE_TAR_FROM
 		, &excludes // --exclude
@@ -1105,7 +1228,9 @@ int tar_main(int argc UNUSED_PARAM, char **argv)
 	showopt(OPT_XZ              );
 	showopt(OPT_COMPRESS        );
 	showopt(OPT_NOPRESERVE_TIME );
+	showopt(OPT_SPARSE          );
 	showopt(OPT_STRIP_COMPONENTS);
+	showopt(OPT_JOBS            );
 	showopt(OPT_NORECURSION     );
 	showopt(OPT_2COMMAND        );
 	showopt(OPT_NUMERIC_OWNER   );
@@ -1204,8 +1329,12 @@ int tar_main(int argc UNUSED_PARAM, char **argv)
 		}
 
 		if (LONE_DASH(tar_filename)) {
+			struct stat st;
+
 			tar_handle->src_fd = tar_fd;
-			tar_handle->seek = seek_by_read;
+			/* "tar -t <FILE" can lseek over file bodies */
+			if (fstat(tar_fd, &st) != 0 || !S_ISREG(st.st_mode))
+				tar_handle->seek = seek_by_read;
 		} else {
 			if (ENABLE_FEATURE_TAR_AUTODETECT
 			 && flags == O_RDONLY
@@ -1245,6 +1374,7 @@ int tar_main(int argc UNUSED_PARAM, char **argv)
 # endif
 		/* NB: writeTarFile() closes tar_handle->src_fd */
 		return writeTarFile(tar_handle->src_fd, verboseFlag,
+				!!(opt & OPT_SPARSE),
 				(opt & OPT_DEREFERENCE ? ACTION_FOLLOWLINKS : 0)
 				| (opt & OPT_NORECURSION ? 0 : ACTION_RECURSE),
 				tar_handle->accept,
@@ -1284,8 +1414,16 @@ int tar_main(int argc UNUSED_PARAM, char **argv)
 	 */
 	bb_got_signal = EXIT_FAILURE;
 
+#if ENABLE_FEATURE_TAR_JOBS
+	if (jobs > 1 && tar_handle->action_data == data_extract_all)
+		tar_jobs_start(tar_handle, jobs);
+#endif
 	while (get_header_tar(tar_handle) == EXIT_SUCCESS)
 		bb_got_signal = EXIT_SUCCESS; /* saw at least one header, good */
+#if ENABLE_FEATURE_TAR_JOBS
+	if (tar_handle->tar__jobs && tar_jobs_finish(tar_handle))
+		bb_got_signal = EXIT_FAILURE;
+#endif
 
 	/* Check that every file that should have been extracted was */
 	while (tar_handle->accept) {
@@ -24,6 +24,16 @@
 //config:	help
 //config:	  Enable long options for cp.
 //config:	  Also add support for --parents option.
+//config:
+//config:config FEATURE_CP_REFLINK
+//config:	bool "Support --reflink"
+//config:	default y
+//config:	depends on FEATURE_CP_LONG_OPTIONS
+//config:	select PLATFORM_LINUX
+//config:	help
+//config:	  Add support for --reflink[=always|auto|never] option:
+//config:	  on filesystems which support it (btrfs, XFS...), the copy
+//config:	  shares data blocks with the source until either is modified.
 
 //applet:IF_CP(APPLET_NOEXEC(cp, cp, BB_DIR_BIN, BB_SUID_DROP, cp))
 
@@ -48,6 +58,12 @@
 //usage:     "\n	-i	Prompt before overwrite"
 //usage:     "\n	-l,-s	Create (sym)links"
 //usage:     "\n	-u	Copy only newer files"
+//usage:	IF_FEATURE_CP_LONG_OPTIONS(
+//usage:     "\n	--sparse=auto|always|never	Make holes in DEST (auto: if SOURCE has them)"
+//usage:	)
+//usage:	IF_FEATURE_CP_REFLINK(
+//usage:     "\n	--reflink[=always|auto|never]	Share data blocks with SOURCE"
+//usage:	)
 
 #include "libbb.h"
 #include "libcoreutils/coreutils.h"
@@ -65,11 +81,15 @@ int cp_main(int argc, char **argv)
 	int d_flags;
 	int flags;
 	int status;
+	IF_FEATURE_CP_LONG_OPTIONS(const char *sparse;)
+	IF_FEATURE_CP_REFLINK(const char *reflink = NULL;)
 	enum {
 		FILEUTILS_CP_OPTNUM = sizeof(FILEUTILS_CP_OPTSTR)-1,
 #if ENABLE_FEATURE_CP_LONG_OPTIONS
 		/*OPT_rmdest  = FILEUTILS_RMDEST = 1 << FILEUTILS_CP_OPTNUM */
 		OPT_parents = 1 << (FILEUTILS_CP_OPTNUM+1),
+		OPT_sparse  = 1 << (FILEUTILS_CP_OPTNUM+2),
+		OPT_reflink = (1 << (FILEUTILS_CP_OPTNUM+3)) * ENABLE_FEATURE_CP_REFLINK,
 #endif
 	};
 
@@ -94,9 +114,15 @@ int cp_main(int argc, char **argv)
 		"update\0"         No_argument "u"
 		"remove-destination\0" No_argument "\xff"
 		"parents\0"        No_argument "\xfe"
+		"sparse\0"         Required_argument "\xfd"
+		IF_FEATURE_CP_REFLINK(
+		"reflink\0"        Optional_argument "\xfc"
+		)
 		;
 #endif
-	flags = getopt32(argv, FILEUTILS_CP_OPTSTR);
+	flags = getopt32(argv, FILEUTILS_CP_OPTSTR
+			IF_FEATURE_CP_LONG_OPTIONS(, &sparse)
+			IF_FEATURE_CP_REFLINK(, &reflink));
 	/* Options of cp from GNU coreutils 6.10:
 	 * -a, --archive
 	 * -f, --force
@@ -118,6 +144,10 @@ int cp_main(int argc, char **argv)
 	 *	remove each existing destination file before attempting to open
 	 * --parents
 	 *	use full source file name under DIRECTORY
+	 * --reflink[=WHEN]
+	 *	clone data blocks if possible (auto), or fail (always, default)
+	 * --sparse=WHEN
+	 *	control creation of sparse files
 	 * NOT SUPPORTED IN BBOX:
 	 * --backup[=CONTROL]
 	 *	make a backup of each existing destination file
@@ -128,8 +158,6 @@ int cp_main(int argc, char **argv)
 	 *	preserve attributes (default: mode,ownership,timestamps),
 	 *	if possible additional attributes: security context,links,all
 	 * --no-preserve=ATTR_LIST
-	 * --sparse=WHEN
-	 *	control creation of sparse files
 	 * --strip-trailing-slashes
 	 *	remove any trailing slashes from each SOURCE argument
 	 * -S, --suffix=SUFFIX
@@ -153,6 +181,32 @@ int cp_main(int argc, char **argv)
 	 * However, "cp -RL" must still deref symlinks: */
 	if (flags & FILEUTILS_DEREF_SOFTLINK) /* -L */
 		flags |= FILEUTILS_DEREFERENCE;
+#if ENABLE_FEATURE_CP_LONG_OPTIONS
+	if (flags & OPT_sparse) {
+		/* "auto" is the default: keep holes the source has */
+		static const char sparse_words[] ALIGN1 =
+			"auto\0""always\0""never\0";
+		int n = index_in_strings(sparse_words, sparse);
+		if (n < 0)
+			bb_error_msg_and_die(bb_msg_invalid_arg_to, sparse, "--sparse");
+		flags &= ~OPT_sparse;
+		if (n == 1)
+			flags |= FILEUTILS_SPARSE_ALWAYS;
+		if (n == 2)
+			flags |= FILEUTILS_SPARSE_NEVER;
+	}
+#endif
+#if ENABLE_FEATURE_CP_REFLINK
+	if (flags & OPT_reflink) {
+		flags &= ~OPT_reflink;
+		if (!reflink || strcmp(reflink, "always") == 0)
+			flags |= FILEUTILS_REFLINK | FILEUTILS_REFLINK_ALWAYS;
+		else if (strcmp(reflink, "auto") == 0)
+			flags |= FILEUTILS_REFLINK;
+		else if (strcmp(reflink, "never") != 0)
+			bb_error_msg_and_die(bb_msg_invalid_arg_to, reflink, "--reflink");
+	}
+#endif
 
 #if ENABLE_SELINUX
 	if (flags & FILEUTILS_PRESERVE_SECURITY_CONTEXT) {
@@ -57,7 +57,7 @@
 
 //usage:#define dd_trivial_usage
 //usage:       "[if=FILE] [of=FILE] " IF_FEATURE_DD_IBS_OBS("[ibs=N] [obs=N] ") "[bs=N] [count=N] [skip=N]\n"
-//usage:       "	[seek=N]" IF_FEATURE_DD_IBS_OBS(" [conv=notrunc|noerror|sync|fsync] [iflag=skip_bytes]")
+//usage:       "	[seek=N]" IF_FEATURE_DD_IBS_OBS(" [conv=notrunc|noerror|sync|fsync|sparse] [iflag=skip_bytes]")
 //usage:#define dd_full_usage "\n\n"
 //usage:       "Copy a file with converting and formatting\n"
 //usage:     "\n	if=FILE		Read from FILE instead of stdin"
@@ -78,6 +78,7 @@
 //usage:     "\n	conv=sync	Pad blocks with zeros"
 //usage:     "\n	conv=fsync	Physically write data out before finishing"
 //usage:     "\n	conv=swab	Swap every pair of bytes"
+//usage:     "\n	conv=sparse	Seek over output blocks of zeros"
 //usage:     "\n	iflag=skip_bytes	skip=N is in bytes"
 //usage:	)
 //usage:	IF_FEATURE_DD_STATUS(
@@ -126,16 +127,17 @@ enum {
 	FLAG_NOERROR = (1 << 2) * ENABLE_FEATURE_DD_IBS_OBS,
 	FLAG_FSYNC   = (1 << 3) * ENABLE_FEATURE_DD_IBS_OBS,
 	FLAG_SWAB    = (1 << 4) * ENABLE_FEATURE_DD_IBS_OBS,
+	FLAG_SPARSE  = (1 << 5) * ENABLE_FEATURE_DD_IBS_OBS,
 	/* end of conv flags */
 	/* start of input flags */
-	FLAG_IFLAG_SHIFT = 5,
-	FLAG_SKIP_BYTES = (1 << 5) * ENABLE_FEATURE_DD_IBS_OBS,
+	FLAG_IFLAG_SHIFT = 6,
+	FLAG_SKIP_BYTES = (1 << 6) * ENABLE_FEATURE_DD_IBS_OBS,
 	/* end of input flags */
-	FLAG_TWOBUFS = (1 << 6) * ENABLE_FEATURE_DD_IBS_OBS,
-	FLAG_COUNT   = 1 << 7,
-	FLAG_STATUS  = 1 << 8,
-	FLAG_STATUS_NONE = 1 << 9,
-	FLAG_STATUS_NOXFER = 1 << 10,
+	FLAG_TWOBUFS = (1 << 7) * ENABLE_FEATURE_DD_IBS_OBS,
+	FLAG_COUNT   = 1 << 8,
+	FLAG_STATUS  = 1 << 9,
+	FLAG_STATUS_NONE = 1 << 10,
+	FLAG_STATUS_NOXFER = 1 << 11,
 };
 
 static void dd_output_status(int UNUSED_PARAM cur_signal)
@@ -184,7 +186,16 @@ static void dd_output_status(int UNUSED_PARAM cur_signal)
 static ssize_t full_write_or_warn(const void *buf, size_t len,
 	const char *const filename)
 {
-	ssize_t n = full_write(ofd, buf, len);
+	ssize_t n;
+
+	/* conv=sparse: like coreutils, seek over whole blocks of zeros */
+	if ((G.flags & FLAG_SPARSE)
+	 && is_zero_block(buf, len)
+	 && lseek(ofd, len, SEEK_CUR) != (off_t)-1
+	) {
+		return len;
+	}
+	n = full_write(ofd, buf, len);
 	if (n < 0)
 		bb_perror_msg("writing '%s'", filename);
 	return n;
@@ -250,7 +261,7 @@ int dd_main(int argc UNUSED_PARAM, char **argv)
 		;
 #if ENABLE_FEATURE_DD_IBS_OBS
 	static const char conv_words[] ALIGN1 =
-		"notrunc\0""sync\0""noerror\0""fsync\0""swab\0";
+		"notrunc\0""sync\0""noerror\0""fsync\0""swab\0""sparse\0";
 	static const char iflag_words[] ALIGN1 =
 		"skip_bytes\0";
 #endif
@@ -277,6 +288,7 @@ int dd_main(int argc UNUSED_PARAM, char **argv)
 		OP_conv_noerror,
 		OP_conv_fsync,
 		OP_conv_swab,
+		OP_conv_sparse,
 	/* Unimplemented conv=XXX: */
 	//nocreat       do not create the output file
 	//excl          fail if the output file already exists
@@ -555,6 +567,10 @@ int dd_main(int argc UNUSED_PARAM, char **argv)
 			goto out_status;
 	}
 
+	/* Output may end in a skipped block */
+	if ((G.flags & FLAG_SPARSE) && full_write_sparse_end(ofd) != 0)
+		goto die_outfile;
+
 	if (!devzero && close(ifd) < 0) {
  die_infile:
 		bb_simple_perror_msg_and_die(infile);
@@ -31,6 +31,16 @@
 //config:	depends on DU
 //config:	help
 //config:	  Use a blocksize of (1K) instead of the default 512b.
+//config:
+//config:config FEATURE_DU_PARALLEL
+//config:	bool "Enable -j N: walk directories with N processes"
+//config:	default y
+//config:	depends on DU && !NOMMU && PLATFORM_POSIX
+//config:	help
+//config:	  With -j N, subtrees are stat'ed by N worker processes,
+//config:	  which helps when every stat has high latency (network
+//config:	  filesystems, cold caches on big trees). Output is the same
+//config:	  as without -j.
 
 //applet:IF_DU(APPLET(du, BB_DIR_USR_BIN, BB_SUID_DROP))
 
@@ -40,7 +50,7 @@
 /* http://www.opengroup.org/onlinepubs/007904975/utilities/du.html */
 
 //usage:#define du_trivial_usage
-//usage:       "[-aHLdclsx" IF_FEATURE_HUMAN_READABLE("hm") "k] [FILE]..."
+//usage:       "[-aHLdclsx" IF_FEATURE_HUMAN_READABLE("hm") "k]" IF_FEATURE_DU_PARALLEL(" [-j N]") " [FILE]..."
 //usage:#define du_full_usage "\n\n"
 //usage:       "Summarize disk space used for each FILE and/or directory\n"
 //usage:     "\n	-a	Show file sizes too"
@@ -51,6 +61,9 @@
 //usage:     "\n	-l	Count sizes many times if hard linked"
 //usage:     "\n	-s	Display only a total for each argument"
 //usage:     "\n	-x	Skip directories on different filesystems"
+//usage:	IF_FEATURE_DU_PARALLEL(
+//usage:     "\n	-j N	Walk directories with N processes"
+//usage:	)
 //usage:	IF_FEATURE_HUMAN_READABLE(
 //usage:     "\n	-h	Sizes in human readable format (e.g., 1K 243M 2G)"
 //usage:     "\n	-m	Sizes in megabytes"
@@ -88,6 +101,7 @@ enum {
 	OPT_c_total        = (1 << 8),
 	OPT_h_for_humans   = (1 << 9),
 	OPT_m_mbytes       = (1 << 10),
+	OPT_j_jobs         = (1 << (9 + 2 * ENABLE_FEATURE_HUMAN_READABLE)),
 };
 
 struct globals {
@@ -101,6 +115,9 @@ struct globals {
 	int slink_depth;
 	int du_depth;
 	dev_t dir_dev;
+#if ENABLE_FEATURE_DU_PARALLEL
+	unsigned max_jobs;
+#endif
 } FIX_ALIASING;
 #define G (*(struct globals*)bb_common_bufsiz1)
 #define INIT_G() do { setup_common_bufsiz(); } while (0)
@@ -137,42 +154,50 @@ static void print(unsigned long long size, const char *filename)
 #endif
 }
 
-/* tiny recursive du */
-static unsigned long long du(const char *filename)
+/* Stat the entry the way du counts it. Returns 0 if it doesn't count */
+static int du_stat(dir_walk_t *w, int dir_fd, const char *name, struct stat *statbuf)
 {
-	struct stat statbuf;
-	unsigned long long sum;
-
-	if (lstat(filename, &statbuf) != 0) {
-		bb_simple_perror_msg(filename);
-		G.status = EXIT_FAILURE;
-		return 0;
-	}
+#define filename (w->path)
+	if (dir_walk_stat(w, dir_fd, name, statbuf, 0) != 0)
+		goto err;
 
 	if (option_mask32 & OPT_x_one_FS) {
 		if (G.du_depth == 0) {
-			G.dir_dev = statbuf.st_dev;
-		} else if (G.dir_dev != statbuf.st_dev) {
+			G.dir_dev = statbuf->st_dev;
+		} else if (G.dir_dev != statbuf->st_dev) {
 			return 0;
 		}
 	}
 
-	sum = statbuf.st_blocks;
-
-	if (S_ISLNK(statbuf.st_mode)) {
+	if (S_ISLNK(statbuf->st_mode)) {
 		if (G.slink_depth > G.du_depth) { /* -H or -L */
-			if (stat(filename, &statbuf) != 0) {
-				bb_simple_perror_msg(filename);
-				G.status = EXIT_FAILURE;
-				return 0;
-			}
-			sum = statbuf.st_blocks;
+			if (dir_walk_stat(w, dir_fd, name, statbuf, 1) != 0)
+				goto err;
 			if (G.slink_depth == 1) {
 				/* Convert -H to -L */
 				G.slink_depth = INT_MAX;
 			}
 		}
 	}
+	return 1;
+ err:
+	bb_simple_perror_msg(filename);
+	G.status = EXIT_FAILURE;
+	return 0;
+#undef filename
+}
+
+/* tiny recursive du */
+static unsigned long long du(dir_walk_t *w, int dir_fd, const char *name)
+{
+	struct stat statbuf;
+	unsigned long long sum;
+#define filename (w->path)
+
+	if (!du_stat(w, dir_fd, name, &statbuf))
+		return 0;
+
+	sum = statbuf.st_blocks;
 
 	if (!(option_mask32 & OPT_l_hardlinks)
 	 && statbuf.st_nlink > 1
@@ -187,22 +212,25 @@ static unsigned long long du(const char *filename)
 	if (S_ISDIR(statbuf.st_mode)) {
 		DIR *dir;
 		struct dirent *entry;
-		char *newfile;
 
-		dir = warn_opendir(filename);
+		/* Like opendir(), follows a link to dir (seen with -H/-L) */
+		dir = dir_walk_opendir(w, dir_fd, name, 1);
 		if (!dir) {
+			bb_perror_msg("can't open '%s'", filename);
 			G.status = EXIT_FAILURE;
 			return sum;
 		}
 
 		while ((entry = readdir(dir))) {
-			newfile = concat_subpath_file(filename, entry->d_name);
-			if (newfile == NULL)
+			unsigned len;
+
+			if (DOT_OR_DOTDOT(entry->d_name))
 				continue;
+			len = dir_walk_push(w, entry->d_name);
 			++G.du_depth;
-			sum += du(newfile);
+			sum += du(w, dir_walk_fd(dir), entry->d_name);
 			--G.du_depth;
-			free(newfile);
+			dir_walk_pop(w, len);
 		}
 		closedir(dir);
 	} else {
@@ -213,14 +241,589 @@ static unsigned long long du(const char *filename)
 		print(sum, filename);
 	}
 	return sum;
+#undef filename
+}
+
+#if ENABLE_FEATURE_DU_PARALLEL
+/* -j N: as in find -j, the top of the tree is read by the parent
+ * and cut into slots in the order du visits them. What is below
+ * (tree slots) is walked by N worker processes, which pull jobs
+ * (runs of tree slots) from a pipe. Workers print nothing: they write
+ * records of what they have seen into unlinked temp files, and the
+ * parent replays them in slot order, adding up directory sums bottom-up
+ * and counting hard links once. Thus output is the same as without -j.
+ */
+enum {
+	DU_REC_DIR,   /* directory, its contents and DU_REC_END follow */
+	DU_REC_END,   /* end of directory, blocks: files not sent on their own */
+	DU_REC_FILE,
+};
+enum {
+	DU_HASHED  = (1 << 0), /* has hard links: count only once */
+	DU_NOPRINT = (1 << 1), /* DU_REC_END of a dir we couldn't read */
+};
+
+struct du_rec {
+	unsigned long long blocks;
+	ino_t ino;
+	dev_t dev;
+	unsigned short namelen; /* NUL terminated name follows, if != 0 */
+	unsigned char type;
+	unsigned char flags;
+};
+
+struct du_slot {
+	char *path;          /* tree slot: walk it */
+	struct du_rec *rec;  /* else: replay this */
+	int depth;
+	int up;              /* slot of the directory record it is in, or -1 */
+	unsigned char type;  /* d_type of tree slot */
+	smallint done;
+	int fd;              /* worker records are [start,end) of fd */
+	off_t start, end;
+};
+
+struct du_job {
+	unsigned first, last;
+};
+
+struct du_result {
+	unsigned job;
+	int status;
+	int worker;
+	off_t start, end;
+};
+
+/* Directories we are in: with -L, don't walk into one of them again */
+struct du_anc {
+	const struct du_anc *up;
+	ino_t ino;
+	dev_t dev;
+};
+
+struct du_par {
+	struct du_slot *slots;
+	unsigned count;
+	struct du_job *jobs;
+	unsigned njobs;
+	/* Replay state */
+	dir_walk_t w;
+	struct du_level {
+		unsigned long long sum;
+		unsigned len;
+	} *stack;
+	unsigned depth;     /* directories open */
+	unsigned skip;      /* > 0: in a directory counted before */
+	unsigned long long total;
+};
+
+/* Consecutive entries walked as one job */
+enum { DU_JOB_SLOTS = 64 };
+enum { DU_REPLAY_BUFSIZE = 64 * 1024 };
+
+static int du_tmpfile(void)
+{
+	const char *tmp_dir = getenv("TMPDIR");
+	char *name;
+	int fd;
+
+	if (!tmp_dir || !tmp_dir[0])
+		tmp_dir = "/tmp";
+	name = concat_path_file(tmp_dir, "duXXXXXX");
+	fd = xmkstemp(name);
+	unlink(name);
+	free(name);
+	return fd;
+}
+
+static void fill_rec(struct du_rec *r, int type, int flags,
+		unsigned long long blocks, const struct stat *st, const char *name)
+{
+	memset(r, 0, sizeof(*r));
+	r->blocks = blocks;
+	if (st) {
+		r->ino = st->st_ino;
+		r->dev = st->st_dev;
+	}
+	if (name)
+		r->namelen = strlen(name) + 1;
+	r->type = type;
+	r->flags = flags;
+}
+
+/* Worker side */
+static void put_rec(int type, int flags,
+		unsigned long long blocks, const struct stat *st, const char *name)
+{
+	struct du_rec r;
+
+	fill_rec(&r, type, flags, blocks, st, name);
+	fwrite(&r, sizeof(r), 1, stdout);
+	if (name)
+		fwrite(name, r.namelen, 1, stdout);
+}
+
+/* Would du() print this non-directory? */
+static int du_prints_file(void)
+{
+	return (G.du_depth == 0 || (option_mask32 & OPT_a_files_too))
+		&& G.du_depth <= G.max_print_depth;
+}
+
+static void du_tree(dir_walk_t *w, int dir_fd, const char *name,
+		unsigned long long *files, const struct du_anc *up)
+{
+	struct stat statbuf;
+	unsigned flags = 0;
+
+	if (!du_stat(w, dir_fd, name, &statbuf))
+		return;
+	if (!(option_mask32 & OPT_l_hardlinks) && statbuf.st_nlink > 1)
+		flags = DU_HASHED;
+
+	if (S_ISDIR(statbuf.st_mode)) {
+		unsigned long long dir_files = 0;
+		struct du_anc me;
+		const struct du_anc *a;
+		DIR *dir;
+		struct dirent *entry;
+
+		/* Only loops are cut here, the parent drops
+		 * whatever else was seen before */
+		for (a = up; a; a = a->up)
+			if (a->ino == statbuf.st_ino && a->dev == statbuf.st_dev)
+				return;
+		me.up = up;
+		me.ino = statbuf.st_ino;
+		me.dev = statbuf.st_dev;
+		put_rec(DU_REC_DIR, flags, statbuf.st_blocks, &statbuf, bb_basename(name));
+		dir = dir_walk_opendir(w, dir_fd, name, 1);
+		if (!dir) {
+			bb_perror_msg("can't open '%s'", w->path);
+			G.status = EXIT_FAILURE;
+			put_rec(DU_REC_END, DU_NOPRINT, 0, NULL, NULL);
+			return;
+		}
+		while ((entry = readdir(dir))) {
+			unsigned len;
+
+			if (DOT_OR_DOTDOT(entry->d_name))
+				continue;
+			len = dir_walk_push(w, entry->d_name);
+			++G.du_depth;
+			du_tree(w, dir_walk_fd(dir), entry->d_name, &dir_files, &me);
+			--G.du_depth;
+			dir_walk_pop(w, len);
+		}
+		closedir(dir);
+		put_rec(DU_REC_END, 0, dir_files, NULL, NULL);
+		return;
+	}
+
+	if (flags || du_prints_file()) {
+		put_rec(DU_REC_FILE, flags, statbuf.st_blocks, &statbuf,
+				du_prints_file() ? bb_basename(name) : NULL);
+	} else {
+		/* Plain file: only its size matters */
+		*files += statbuf.st_blocks;
+	}
 }
 
+static void NORETURN du_worker(struct du_par *p, int job_fd, int res_fd, int worker)
+{
+	struct du_result res;
+	unsigned j;
+
+	res.worker = worker;
+	while (full_read(job_fd, &j, sizeof(j)) == sizeof(j)) {
+		unsigned long long files = 0;
+		struct du_anc *anc;
+		unsigned i, n;
+		int k;
+
+		/* The directories the parent walked down to the job */
+		i = p->jobs[j].first;
+		anc = xmalloc((p->slots[i].depth + 1) * sizeof(anc[0]));
+		n = 0;
+		for (k = p->slots[i].up; k >= 0; k = p->slots[k].up) {
+			anc[n].up = &anc[n + 1];
+			anc[n].ino = p->slots[k].rec->ino;
+			anc[n].dev = p->slots[k].rec->dev;
+			n++;
+		}
+		if (n)
+			anc[n - 1].up = NULL;
+
+		res.job = j;
+		res.start = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+		for (i = p->jobs[j].first; i < p->jobs[j].last; i++) {
+			struct du_slot *sl = &p->slots[i];
+			dir_walk_t w;
+
+			dir_walk_init(&w, sl->path);
+			G.du_depth = sl->depth;
+			du_tree(&w, AT_FDCWD, sl->path, &files, n ? anc : NULL);
+			free(w.path);
+		}
+		free(anc);
+		/* Slots of a job are in one directory */
+		if (files)
+			put_rec(DU_REC_FILE, 0, files, NULL, NULL);
+		fflush_all();
+		res.end = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+		res.status = G.status;
+		xwrite(res_fd, &res, sizeof(res));
+	}
+	_exit(EXIT_SUCCESS);
+}
+
+/* Parent side */
+static struct du_slot *new_slot(struct du_par *p, int depth)
+{
+	struct du_slot *sl;
+
+	p->slots = xrealloc_vector(p->slots, 6, p->count);
+	sl = &p->slots[p->count++];
+	memset(sl, 0, sizeof(*sl));
+	sl->depth = depth;
+	sl->fd = -1;
+	return sl;
+}
+
+static void new_rec_slot(struct du_par *p, int depth, int type, int flags,
+		unsigned long long blocks, const struct stat *st, const char *name)
+{
+	struct du_rec r, *rec;
+
+	fill_rec(&r, type, flags, blocks, st, name);
+	rec = xmalloc(sizeof(r) + r.namelen);
+	*rec = r;
+	if (name)
+		strcpy((char*)(rec + 1), name);
+	new_slot(p, depth)->rec = rec;
+}
+
+static int maybe_dir(struct du_slot *sl)
+{
+	return sl->path
+		&& (sl->type == DT_DIR
+		 || sl->type == DT_UNKNOWN
+		 || (sl->type == DT_LNK && G.slink_depth > sl->depth)
+		);
+}
+
+/* Replace tree slot with records of it, and tree slots of
+ * what is in it */
+static void expand_slot(struct du_par *p, struct du_slot *tree)
+{
+	struct stat st;
+	dir_walk_t w;
+	unsigned flags = 0;
+	const char *name;
+	DIR *dir;
+	struct dirent *entry;
+
+	/* du_stat() uses only the path of it */
+	w.path = tree->path;
+	name = bb_basename(tree->path);
+	G.du_depth = tree->depth;
+	if (!du_stat(&w, AT_FDCWD, tree->path, &st))
+		goto ret;
+	if (!(option_mask32 & OPT_l_hardlinks) && st.st_nlink > 1)
+		flags = DU_HASHED;
+	if (!S_ISDIR(st.st_mode)) {
+		new_rec_slot(p, tree->depth, DU_REC_FILE, flags, st.st_blocks, &st,
+				du_prints_file() ? name : NULL);
+		goto ret;
+	}
+	new_rec_slot(p, tree->depth, DU_REC_DIR, flags, st.st_blocks, &st, name);
+	dir = dir_walk_opendir(&w, AT_FDCWD, tree->path, 1);
+	if (!dir) {
+		bb_perror_msg("can't open '%s'", tree->path);
+		G.status = EXIT_FAILURE;
+		new_rec_slot(p, tree->depth, DU_REC_END, DU_NOPRINT, 0, NULL, NULL);
+		goto ret;
+	}
+	while ((entry = readdir(dir))) {
+		struct du_slot *sl;
+
+		if (DOT_OR_DOTDOT(entry->d_name))
+			continue;
+		sl = new_slot(p, tree->depth + 1);
+		sl->path = concat_path_file(tree->path, entry->d_name);
+		sl->type = dirent_type(entry);
+	}
+	closedir(dir);
+	new_rec_slot(p, tree->depth, DU_REC_END, 0, 0, NULL, NULL);
+ ret:
+	free(tree->path);
+}
+
+static void split_tree(struct du_par *p, unsigned nworkers)
+{
+	unsigned round;
+	int dir;
+
+	/* Read directories breadth first until there is enough
+	 * subtrees for the workers to share */
+	for (round = 0; round < 8; round++) {
+		struct du_slot *old = p->slots;
+		unsigned count = p->count;
+		unsigned i, dirs = 0;
+
+		for (i = 0; i < count; i++)
+			if (maybe_dir(&old[i]))
+				dirs++;
+		if (dirs == 0 || dirs >= 4 * nworkers)
+			break;
+		p->slots = NULL;
+		p->count = 0;
+		for (i = 0; i < count; i++) {
+			if (maybe_dir(&old[i]))
+				expand_slot(p, &old[i]);
+			else
+				*new_slot(p, 0) = old[i];
+		}
+		free(old);
+	}
+
+	/* Note the directory record each slot is in */
+	for (round = 0, dir = -1; round < p->count; round++) {
+		struct du_slot *sl = &p->slots[round];
+
+		sl->up = dir;
+		if (sl->rec && sl->rec->type == DU_REC_DIR)
+			dir = round;
+		if (sl->rec && sl->rec->type == DU_REC_END)
+			dir = p->slots[dir].up;
+	}
+
+	/* A job ends after a directory, or at a record */
+	for (round = 0; round < p->count;) {
+		unsigned first = round;
+
+		if (!p->slots[round++].path)
+			continue;
+		while (round < p->count
+		 && p->slots[round].path
+		 && !maybe_dir(&p->slots[round - 1])
+		 && round - first < DU_JOB_SLOTS
+		) {
+			round++;
+		}
+		p->jobs = xrealloc_vector(p->jobs, 6, p->njobs);
+		p->jobs[p->njobs].first = first;
+		p->jobs[p->njobs].last = round;
+		p->njobs++;
+	}
+}
+
+static void add_sum(struct du_par *p, unsigned long long sum)
+{
+	if (p->depth != 0)
+		p->stack[p->depth - 1].sum += sum;
+	else
+		p->total += sum;
+}
+
+static void replay(struct du_par *p, const struct du_rec *r, const char *name)
+{
+	unsigned len;
+
+	if (p->skip) {
+		if (r->type == DU_REC_DIR)
+			p->skip++;
+		else if (r->type == DU_REC_END)
+			p->skip--;
+		return;
+	}
+
+	if (r->type == DU_REC_END) {
+		struct du_level *l = &p->stack[--p->depth];
+		unsigned long long sum = l->sum + r->blocks;
+
+		if (!(r->flags & DU_NOPRINT) && p->depth <= G.max_print_depth)
+			print(sum, p->w.path);
+		dir_walk_pop(&p->w, l->len);
+		add_sum(p, sum);
+		return;
+	}
+
+	if (r->flags & DU_HASHED) {
+		struct stat st;
+
+		memset(&st, 0, sizeof(st));
+		st.st_ino = r->ino;
+		st.st_dev = r->dev;
+		st.st_mode = (r->type == DU_REC_DIR) ? S_IFDIR : S_IFREG;
+		if (is_in_ino_dev_hashtable(&st)) {
+			if (r->type == DU_REC_DIR)
+				p->skip = 1;
+			return;
+		}
+		add_to_ino_dev_hashtable(&st, NULL);
+	}
+
+	/* The top directory (or file) is w.path already */
+	len = p->w.len;
+	if (p->depth != 0 && r->namelen)
+		len = dir_walk_push(&p->w, name);
+
+	if (r->type == DU_REC_DIR) {
+		p->stack = xrealloc_vector(p->stack, 4, p->depth);
+		p->stack[p->depth].sum = r->blocks;
+		p->stack[p->depth].len = len;
+		p->depth++;
+		return;
+	}
+
+	if (r->namelen)
+		print(r->blocks, p->w.path);
+	dir_walk_pop(&p->w, len);
+	add_sum(p, r->blocks);
+}
+
+static void replay_range(struct du_par *p, int fd, off_t start, off_t end, char *buf)
+{
+	unsigned have = 0;
+
+	while (start < end) {
+		struct du_rec r;
+		unsigned pos;
+		/* The file offset is shared with the writer, so pread */
+		ssize_t rd = pread(fd, buf + have,
+				MIN(end - start, DU_REPLAY_BUFSIZE - have), start);
+
+		if (rd <= 0)
+			bb_perror_msg_and_die("read error");
+		start += rd;
+		have += rd;
+		pos = 0;
+		while (have - pos >= sizeof(r)) {
+			memcpy(&r, buf + pos, sizeof(r));
+			if (have - pos < sizeof(r) + r.namelen)
+				break;
+			replay(p, &r, buf + pos + sizeof(r));
+			pos += sizeof(r) + r.namelen;
+		}
+		have -= pos;
+		memmove(buf, buf + pos, have);
+	}
+}
+
+/* Replay slots up to the first one still being walked */
+static void flush_slots(struct du_par *p, unsigned *next, char *buf)
+{
+	while (*next < p->count) {
+		struct du_slot *sl = &p->slots[*next];
+
+		if (sl->rec) {
+			replay(p, sl->rec, (char*)(sl->rec + 1));
+		} else {
+			if (!sl->done)
+				break;
+			if (sl->fd >= 0)
+				replay_range(p, sl->fd, sl->start, sl->end, buf);
+		}
+		(*next)++;
+	}
+}
+
+static unsigned long long du_parallel(const char *arg)
+{
+	struct du_par par;
+	struct fd_pair job_pipe, res_pipe;
+	int *out;
+	char *buf;
+	unsigned nworkers, sent, left, next, i;
+
+	memset(&par, 0, sizeof(par));
+	new_slot(&par, 0)->path = xstrdup(arg);
+	split_tree(&par, G.max_jobs);
+
+	/* Children must not inherit unflushed output */
+	fflush_all();
+	nworkers = MIN(G.max_jobs, par.njobs);
+	out = xmalloc((nworkers + 1) * sizeof(out[0]));
+	xpiped_pair(job_pipe);
+	xpiped_pair(res_pipe);
+	for (i = 0; i < nworkers; i++) {
+		out[i] = du_tmpfile();
+		if (xfork() == 0) {
+			/* child */
+			close(job_pipe.wr);
+			close(res_pipe.rd);
+			xdup2(out[i], STDOUT_FILENO);
+			du_worker(&par, job_pipe.rd, res_pipe.wr, i);
+		}
+	}
+	close(job_pipe.rd);
+	close(res_pipe.wr);
+
+	/* Keep the job pipe short: results must not fill their pipe
+	 * while we are blocked writing jobs */
+	sent = 0;
+	while (sent < par.njobs && sent < 2 * nworkers) {
+		xwrite(job_pipe.wr, &sent, sizeof(sent));
+		sent++;
+	}
+	if (sent == par.njobs)
+		close(job_pipe.wr);
+
+	dir_walk_init(&par.w, arg);
+	buf = xmalloc(DU_REPLAY_BUFSIZE);
+	next = 0;
+	flush_slots(&par, &next, buf);
+	for (left = par.njobs; left != 0; left--) {
+		struct du_result res;
+		struct du_slot *sl;
+
+		if (full_read(res_pipe.rd, &res, sizeof(res)) != sizeof(res))
+			bb_error_msg_and_die("worker died");
+		if (res.status)
+			G.status = EXIT_FAILURE;
+		if (sent < par.njobs) {
+			xwrite(job_pipe.wr, &sent, sizeof(sent));
+			if (++sent == par.njobs)
+				close(job_pipe.wr);
+		}
+		for (i = par.jobs[res.job].first; i < par.jobs[res.job].last; i++)
+			par.slots[i].done = 1;
+		sl = &par.slots[par.jobs[res.job].first];
+		sl->fd = out[res.worker];
+		sl->start = res.start;
+		sl->end = res.end;
+		flush_slots(&par, &next, buf);
+	}
+	close(res_pipe.rd);
+	while (wait(NULL) > 0)
+		continue;
+
+	for (i = 0; i < nworkers; i++)
+		close(out[i]);
+	if (ENABLE_FEATURE_CLEAN_UP) {
+		for (i = 0; i < par.count; i++) {
+			free(par.slots[i].path);
+			free(par.slots[i].rec);
+		}
+		free(par.slots);
+		free(par.jobs);
+		free(par.stack);
+		free(par.w.path);
+		free(out);
+		free(buf);
+	}
+	return par.total;
+}
+#endif
+
 int du_main(int argc, char **argv) MAIN_EXTERNALLY_VISIBLE;
 int du_main(int argc UNUSED_PARAM, char **argv)
 {
 	unsigned long long total;
 	int slink_depth_save;
 	unsigned opt;
+	IF_FEATURE_DU_PARALLEL(const char *jobs_str;)
 
 	INIT_G();
 
@@ -243,7 +846,8 @@ int du_main(int argc UNUSED_PARAM, char **argv)
 	 */
 #if ENABLE_FEATURE_HUMAN_READABLE
 	opt_complementary = "h-km:k-hm:m-hk:H-L:L-H:s-d:d-s";
-	opt = getopt32(argv, "aHkLsx" "d:+" "lc" "hm", &G.max_print_depth);
+	opt = getopt32(argv, "aHkLsx" "d:+" "lc" "hm" IF_FEATURE_DU_PARALLEL("j:"),
+			&G.max_print_depth IF_FEATURE_DU_PARALLEL(, &jobs_str));
 	argv += optind;
 	if (opt & OPT_h_for_humans) {
 		G.disp_unit = 0;
@@ -256,7 +860,8 @@ int du_main(int argc UNUSED_PARAM, char **argv)
 	}
 #else
 	opt_complementary = "H-L:L-H:s-d:d-s";
-	opt = getopt32(argv, "aHkLsx" "d:+" "lc", &G.max_print_depth);
+	opt = getopt32(argv, "aHkLsx" "d:+" "lc" IF_FEATURE_DU_PARALLEL("j:"),
+			&G.max_print_depth IF_FEATURE_DU_PARALLEL(, &jobs_str));
 	argv += optind;
 #if !ENABLE_FEATURE_DU_DEFAULT_BLOCKSIZE_1K
 	if (opt & OPT_k_kbytes) {
@@ -273,6 +878,10 @@ int du_main(int argc UNUSED_PARAM, char **argv)
 	if (opt & OPT_s_total_norecurse) {
 		G.max_print_depth = 0;
 	}
+#if ENABLE_FEATURE_DU_PARALLEL
+	if (opt & OPT_j_jobs)
+		G.max_jobs = xatou_range(jobs_str, 1, 1024);
+#endif
 
 	/* go through remaining args (if any) */
 	if (!*argv) {
@@ -285,7 +894,18 @@ int du_main(int argc UNUSED_PARAM, char **argv)
 	slink_depth_save = G.slink_depth;
 	total = 0;
 	do {
-		total += du(*argv);
+#if ENABLE_FEATURE_DU_PARALLEL
+		if (G.max_jobs > 1)
+			total += du_parallel(*argv);
+		else
+#endif
+		{
+			dir_walk_t w;
+
+			dir_walk_init(&w, *argv);
+			total += du(&w, AT_FDCWD, *argv);
+			free(w.path);
+		}
 		/* otherwise du /dir /dir won't show /dir twice: */
 		reset_ino_dev_hashtable();
 		G.slink_depth = slink_depth_save;
@@ -61,6 +61,28 @@
 //config:	help
 //config:	  Allow ls to sort file names alphabetically.
 //config:
+//config:config FEATURE_LS_UNSORTED
+//config:	bool "Enable -U and -f: list in directory order"
+//config:	default y
+//config:	depends on LS && !SELINUX
+//config:	help
+//config:	  Allow ls to list files in the order they are read
+//config:	  from the directory. With one file per line, names are
+//config:	  printed as they are read, which keeps memory use flat on
+//config:	  huge directories. Files are not stat'ed unless the output
+//config:	  needs more than what readdir tells.
+//config:	  (ls has no option bits left for this with SELinux)
+//config:
+//config:config FEATURE_LS_PREFETCH
+//config:	bool "Stat big directories with several processes"
+//config:	default y
+//config:	depends on LS && !NOMMU && PLATFORM_POSIX
+//config:	help
+//config:	  Entries of directories with more than a thousand files
+//config:	  are stat'ed by a few processes at once. This makes
+//config:	  ls -l, -t or -S of such directories much faster where
+//config:	  stat has high latency (network filesystems).
+//config:
 //config:config FEATURE_LS_TIMESTAMPS
 //config:	bool "Show file timestamps"
 //config:	default y
@@ -106,6 +128,7 @@
 //usage:	IF_FEATURE_HUMAN_READABLE("h")
 //usage:	IF_FEATURE_LS_SORTFILES("rSXv")
 //usage:	IF_FEATURE_LS_TIMESTAMPS("ctu")
+//usage:	IF_FEATURE_LS_UNSORTED("fU")
 //usage:	IF_SELINUX("kKZ") "]"
 //usage:	IF_FEATURE_AUTOWIDTH(" [-w WIDTH]") " [FILE]..."
 //usage:#define ls_full_usage "\n\n"
@@ -148,6 +171,10 @@
 //usage:     "\n	-t	With -l: sort by mtime"
 //usage:     "\n	-u	With -l: sort by atime"
 //usage:	)
+//usage:	IF_FEATURE_LS_UNSORTED(
+//usage:     "\n	-U	Don't sort, list in directory order"
+//usage:     "\n	-f	Same as -aU"
+//usage:	)
 //usage:	IF_SELINUX(
 //usage:     "\n	-k	List security context"
 //usage:     "\n	-K	List security context in long format"
@@ -241,6 +268,7 @@ SORT_VERSION    = 5 << 24,      /* sort by version */
 SORT_EXT        = 6 << 24,      /* sort by file name extension */
 SORT_DIR        = 7 << 24,      /* sort by file or directory */
 SORT_MASK       = (7 << 24) * ENABLE_FEATURE_LS_SORTFILES,
+SORT_UNSORTED   = (1 << 27) * ENABLE_FEATURE_LS_UNSORTED, /* -U */
 
 LIST_LONG       = LIST_MODEBITS | LIST_NLINKS | LIST_ID_NAME | LIST_SIZE | \
                   LIST_DATE_TIME | LIST_SYMLINK,
@@ -269,8 +297,9 @@ static const char ls_options[] ALIGN1 =
 	IF_SELINUX("KZ")                 /* 2, 26 */
 	IF_FEATURE_LS_FOLLOWLINKS("LH")  /* 2, 28 */
 	IF_FEATURE_HUMAN_READABLE("h")   /* 1, 29 */
-	IF_FEATURE_AUTOWIDTH("T:w:")     /* 2, 31 */
-	/* with --color, we use all 32 bits */;
+	IF_FEATURE_LS_UNSORTED("fU")     /* 2, 31 - only without KZ */
+	IF_FEATURE_AUTOWIDTH("T:w:")     /* 2, 33 */
+	/* with --color, we use all 32 bits (34 if it were not for KZ) */;
 enum {
 	//OPT_C = (1 << 0),
 	//OPT_a = (1 << 1),
@@ -302,7 +331,9 @@ enum {
 	OPTBIT_L = OPTBIT_K + 2 * ENABLE_SELINUX,
 	OPTBIT_H, /* 27 */
 	OPTBIT_h = OPTBIT_L + 2 * ENABLE_FEATURE_LS_FOLLOWLINKS,
-	OPTBIT_T = OPTBIT_h + 1 * ENABLE_FEATURE_HUMAN_READABLE,
+	OPTBIT_f = OPTBIT_h + 1 * ENABLE_FEATURE_HUMAN_READABLE,
+	OPTBIT_U, /* 28: -U is only there without KZ */
+	OPTBIT_T = OPTBIT_f + 2 * ENABLE_FEATURE_LS_UNSORTED,
 	OPTBIT_w, /* 30 */
 	OPTBIT_color = OPTBIT_T + 2 * ENABLE_FEATURE_AUTOWIDTH,
 
@@ -322,6 +353,8 @@ enum {
 	OPT_L = (1 << OPTBIT_L) * ENABLE_FEATURE_LS_FOLLOWLINKS,
 	OPT_H = (1 << OPTBIT_H) * ENABLE_FEATURE_LS_FOLLOWLINKS,
 	OPT_h = (1 << OPTBIT_h) * ENABLE_FEATURE_HUMAN_READABLE,
+	OPT_f = (1 << OPTBIT_f) * ENABLE_FEATURE_LS_UNSORTED,
+	OPT_U = (1 << OPTBIT_U) * ENABLE_FEATURE_LS_UNSORTED,
 	OPT_T = (1 << OPTBIT_T) * ENABLE_FEATURE_AUTOWIDTH,
 	OPT_w = (1 << OPTBIT_w) * ENABLE_FEATURE_AUTOWIDTH,
 	OPT_color = (1 << OPTBIT_color) * ENABLE_FEATURE_LS_COLOR,
@@ -781,7 +814,25 @@ static void display_files(struct dnode **dn, unsigned nfiles)
 
 /*** Dir scanning code ***/
 
-static struct dnode *my_stat(const char *fullname, const char *name, int force_follow)
+/* Result of [l]stat done in advance */
+struct ls_stat {
+	int err;              /* errno, 0 if ok, -1 if not done */
+	struct stat st;
+};
+
+static int get_stat(const char *fullname, struct stat *statbuf, int follow,
+		const struct ls_stat *pf)
+{
+	if (pf) {
+		*statbuf = pf->st;
+		errno = pf->err;
+		return -(pf->err != 0);
+	}
+	return (follow ? stat : lstat)(fullname, statbuf);
+}
+
+static struct dnode *my_stat(const char *fullname, const char *name, int force_follow,
+		const struct ls_stat *pf)
 {
 	struct stat statbuf;
 	struct dnode *cur;
@@ -796,7 +847,7 @@ static struct dnode *my_stat(const char *fullname, const char *name, int force_f
 			getfilecon(fullname, &cur->sid);
 		}
 #endif
-		if (stat(fullname, &statbuf)) {
+		if (get_stat(fullname, &statbuf, 1, pf)) {
 			bb_simple_perror_msg(fullname);
 			G.exit_code = EXIT_FAILURE;
 			free(cur);
@@ -809,7 +860,7 @@ static struct dnode *my_stat(const char *fullname, const char *name, int force_f
 			lgetfilecon(fullname, &cur->sid);
 		}
 #endif
-		if (lstat(fullname, &statbuf)) {
+		if (get_stat(fullname, &statbuf, 0, pf)) {
 			bb_simple_perror_msg(fullname);
 			G.exit_code = EXIT_FAILURE;
 			free(cur);
@@ -874,6 +925,19 @@ static struct dnode **dnalloc(unsigned num)
 	return xzalloc(num * sizeof(struct dnode *));
 }
 
+/* The list has the last added node first. The array is in the order
+ * nodes were added (-U shows that) */
+static struct dnode **dnlist_to_array(struct dnode *dn, unsigned num)
+{
+	struct dnode **dnp = dnalloc(num);
+
+	while (dn) {
+		dnp[--num] = dn;
+		dn = dn->dn_next;
+	}
+	return dnp;
+}
+
 #if ENABLE_FEATURE_LS_RECURSIVE
 static void dfree(struct dnode **dnp)
 {
@@ -989,6 +1053,8 @@ static int sortcmp(const void *a, const void *b)
 
 static void dnsort(struct dnode **dn, int size)
 {
+	if (G.all_fmt & SORT_UNSORTED)
+		return;
 	qsort(dn, size, sizeof(*dn), sortcmp);
 }
 
@@ -1002,13 +1068,78 @@ static void sort_and_display_files(struct dnode **dn, unsigned nfiles)
 # define sort_and_display_files(dn, nfiles) display_files(dn, nfiles)
 #endif
 
+/* are we going to list the file- it may be . or .. or a hidden file */
+static int hidden_entry(const char *name)
+{
+	if (name[0] == '.') {
+		if ((!name[1] || (name[1] == '.' && !name[2]))
+		 && !(G.all_fmt & DISP_DOT)
+		) {
+			return 1;
+		}
+		if (!(G.all_fmt & DISP_HIDDEN))
+			return 1;
+	}
+	return 0;
+}
+
+#if ENABLE_FEATURE_LS_PREFETCH
+/* Where each stat waits for a server, a few processes stat'ing at once
+ * make ls -l of a big directory several times faster. Results
+ * go to shared memory.
+ */
+enum {
+	PREFETCH_MIN   = 1024, /* fewer entries are not worth the forks */
+	PREFETCH_PROCS = 4,
+};
+
+static struct ls_stat *prefetch_stat(char **names, unsigned n)
+{
+	struct ls_stat *pf;
+	pid_t pid[PREFETCH_PROCS];
+	int follow = (option_mask32 & OPT_L);
+	unsigned w, i;
+
+	if (n < PREFETCH_MIN)
+		return NULL;
+	pf = mmap(NULL, n * sizeof(pf[0]), PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (pf == MAP_FAILED)
+		return NULL;
+	for (i = 0; i < n; i++)
+		pf[i].err = -1;
+
+	/* waitpid must wait for them */
+	signal(SIGCHLD, SIG_DFL);
+	for (w = 0; w < PREFETCH_PROCS; w++) {
+		pid[w] = fork();
+		if (pid[w] == 0) {
+			for (i = w; i < n; i += PREFETCH_PROCS) {
+				pf[i].err = 0;
+				if ((follow ? stat : lstat)(names[i], &pf[i].st))
+					pf[i].err = errno;
+			}
+			_exit(EXIT_SUCCESS);
+		}
+	}
+	for (w = 0; w < PREFETCH_PROCS; w++)
+		if (pid[w] > 0)
+			safe_waitpid(pid[w], NULL, 0);
+	return pf;
+}
+#else
+# define prefetch_stat(names, n) ((struct ls_stat *)NULL)
+#endif
+
 /* Returns NULL-terminated malloced vector of pointers (or NULL) */
 static struct dnode **scan_one_dir(const char *path, unsigned *nfiles_p)
 {
-	struct dnode *dn, *cur, **dnp;
+	struct dnode *cur, **dnp;
 	struct dirent *entry;
 	DIR *dir;
-	unsigned i, nfiles;
+	char **names;
+	struct ls_stat *pf;
+	unsigned i, nnames, nfiles;
 
 	*nfiles_p = 0;
 	dir = warn_opendir(path);
@@ -1016,51 +1147,126 @@ static struct dnode **scan_one_dir(const char *path, unsigned *nfiles_p)
 		G.exit_code = EXIT_FAILURE;
 		return NULL;	/* could not open the dir */
 	}
-	dn = NULL;
-	nfiles = 0;
+	names = NULL;
+	nnames = 0;
 	while ((entry = readdir(dir)) != NULL) {
-		char *fullname;
+		if (hidden_entry(entry->d_name))
+			continue;
+		names = xrealloc_vector(names, 6, nnames);
+		names[nnames++] = concat_path_file(path, entry->d_name);
+	}
+	closedir(dir);
 
-		/* are we going to list the file- it may be . or .. or a hidden file */
-		if (entry->d_name[0] == '.') {
-			if ((!entry->d_name[1] || (entry->d_name[1] == '.' && !entry->d_name[2]))
-			 && !(G.all_fmt & DISP_DOT)
-			) {
-				continue;
-			}
-			if (!(G.all_fmt & DISP_HIDDEN))
-				continue;
-		}
-		fullname = concat_path_file(path, entry->d_name);
-		cur = my_stat(fullname, bb_basename(fullname), 0);
+	/* Big directory? Stat it with a few processes */
+	pf = prefetch_stat(names, nnames);
+
+	dnp = dnalloc(nnames);
+	nfiles = 0;
+	for (i = 0; i < nnames; i++) {
+		char *fullname = names[i];
+
+		/* A worker that didn't finish left err == -1 */
+		cur = my_stat(fullname, bb_basename(fullname), 0,
+				(pf && pf[i].err != -1) ? &pf[i] : NULL);
 		if (!cur) {
 			free(fullname);
 			continue;
 		}
 		cur->fname_allocated = 1;
-		cur->dn_next = dn;
-		dn = cur;
-		nfiles++;
+		dnp[nfiles++] = cur;
 	}
-	closedir(dir);
+	free(names);
+	if (pf)
+		munmap(pf, nnames * sizeof(pf[0]));
 
-	if (dn == NULL)
+	if (nfiles == 0) {
+		free(dnp);
 		return NULL;
-
-	/* now that we know how many files there are
-	 * allocate memory for an array to hold dnode pointers
-	 */
+	}
 	*nfiles_p = nfiles;
-	dnp = dnalloc(nfiles);
-	for (i = 0; /* i < nfiles - detected via !dn below */; i++) {
-		dnp[i] = dn;	/* save pointer to node in array */
-		dn = dn->dn_next;
-		if (!dn)
-			break;
+	return dnp;
+}
+
+#if ENABLE_FEATURE_LS_UNSORTED
+/* Can we print entries as they are read? */
+static int stream_dirs(void)
+{
+	return (G.all_fmt & SORT_UNSORTED)
+		/* one file per line */
+		&& (G.all_fmt & STYLE_MASK) != STYLE_COLUMNAR
+		/* no "total" line before them */
+		&& !(ENABLE_DESKTOP
+		    && ((G.all_fmt & STYLE_MASK) == STYLE_LONG || (G.all_fmt & LIST_BLOCKS))
+		);
+}
+
+/* Print entries as readdir returns them. Only names are kept,
+ * of subdirectories to recurse into with -R: they are returned
+ * the way scan_one_dir() does it.
+ */
+static struct dnode **stream_one_dir(const char *path, unsigned *ndirs_p)
+{
+	struct dnode *dirs, *cur;
+	struct dirent *entry;
+	DIR *dir;
+	unsigned ndirs;
+	/* Does output need more than the name and d_type? */
+	int need_stat = (G.all_fmt & LIST_MASK & ~LIST_FILETYPE)
+			|| G_show_color
+			|| (option_mask32 & OPT_L);
+
+	*ndirs_p = 0;
+	dir = warn_opendir(path);
+	if (dir == NULL) {
+		G.exit_code = EXIT_FAILURE;
+		return NULL;	/* could not open the dir */
 	}
+	dirs = NULL;
+	ndirs = 0;
+	while ((entry = readdir(dir)) != NULL) {
+		char *fullname;
+		unsigned type;
 
-	return dnp;
+		if (hidden_entry(entry->d_name))
+			continue;
+		fullname = concat_path_file(path, entry->d_name);
+		type = dirent_type(entry);
+		if (need_stat || type == DT_UNKNOWN) {
+			cur = my_stat(fullname, bb_basename(fullname), 0, NULL);
+			if (!cur) {
+				free(fullname);
+				continue;
+			}
+		} else {
+			cur = xzalloc(sizeof(*cur));
+			cur->fullname = fullname;
+			cur->name = bb_basename(fullname);
+			cur->dn_mode = DTTOIF(type);
+		}
+		cur->fname_allocated = 1;
+		display_single(cur);
+		putchar('\n');
+
+		if ((G.all_fmt & DISP_RECURSIVE)
+		 && S_ISDIR(cur->dn_mode)
+		 && !DOT_OR_DOTDOT(cur->name)
+		) {
+			cur->dn_next = dirs;
+			dirs = cur;
+			ndirs++;
+		} else {
+			free(fullname);
+			free(cur);
+		}
+	}
+	closedir(dir);
+
+	if (dirs == NULL)
+		return NULL;
+	*ndirs_p = ndirs;
+	return dnlist_to_array(dirs, ndirs);
 }
+#endif
 
 #if ENABLE_DESKTOP
 /* http://www.opengroup.org/onlinepubs/9699919799/utilities/ls.html
@@ -1103,6 +1309,17 @@ static void scan_and_display_dirs_recur(struct dnode **dn, int first)
 			first = 0;
 			printf("%s:\n", (*dn)->fullname);
 		}
+#if ENABLE_FEATURE_LS_UNSORTED
+		if (stream_dirs()) {
+			/* Only subdirs are returned */
+			subdnp = stream_one_dir((*dn)->fullname, &nfiles);
+			if (nfiles > 0) {
+				scan_and_display_dirs_recur(subdnp, 0);
+				dfree(subdnp);
+			}
+			continue;
+		}
+#endif
 		subdnp = scan_one_dir((*dn)->fullname, &nfiles);
 #if ENABLE_DESKTOP
 		if ((G.all_fmt & STYLE_MASK) == STYLE_LONG || (G.all_fmt & LIST_BLOCKS))
@@ -1241,6 +1458,13 @@ int ls_main(int argc UNUSED_PARAM, char **argv)
 	}
 #endif
 
+#if ENABLE_FEATURE_LS_UNSORTED
+	if (opt & (OPT_f | OPT_U))
+		G.all_fmt |= SORT_UNSORTED;
+	if (opt & OPT_f)
+		G.all_fmt |= DISP_HIDDEN | DISP_DOT;
+#endif
+
 	/* sort out which command line options take precedence */
 	if (ENABLE_FEATURE_LS_RECURSIVE && (G.all_fmt & DISP_NOLIST))
 		G.all_fmt &= ~DISP_RECURSIVE;	/* no recurse if listing only dir */
@@ -1277,6 +1501,7 @@ int ls_main(int argc UNUSED_PARAM, char **argv)
 			/* ... or if -H: */
 			|| (option_mask32 & OPT_H)
 			/* ... or if -L, but my_stat always follows links if -L */
+			, NULL
 		);
 		argv++;
 		if (!cur)
@@ -1294,13 +1519,7 @@ int ls_main(int argc UNUSED_PARAM, char **argv)
 	/* now that we know how many files there are
 	 * allocate memory for an array to hold dnode pointers
 	 */
-	dnp = dnalloc(nfiles);
-	for (i = 0; /* i < nfiles - detected via !dn below */; i++) {
-		dnp[i] = dn;	/* save pointer to node in array */
-		dn = dn->dn_next;
-		if (!dn)
-			break;
-	}
+	dnp = dnlist_to_array(dn, nfiles);
 
 	if (G.all_fmt & DISP_NOLIST) {
 		sort_and_display_files(dnp, nfiles);
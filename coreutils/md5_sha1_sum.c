@@ -47,6 +47,14 @@
 //config:	  against pre-calculated hash values.
 //config:
 //config:	  -s and -w are useful options when verifying checksums.
+//config:
+//config:config FEATURE_MD5_SHA1_SUM_PARALLEL
+//config:	bool "Enable -j N option (hash files in parallel)"
+//config:	default y
+//config:	depends on (MD5SUM || SHA1SUM || SHA256SUM || SHA512SUM || SHA3SUM) && !NOMMU && PLATFORM_POSIX
+//config:	help
+//config:	  -j N hashes files (given on command line or listed in -c FILEs)
+//config:	  in N worker processes. Results are printed in the usual order.
 
 //applet:IF_MD5SUM(APPLET_NOEXEC(md5sum, md5_sha1_sum, BB_DIR_USR_BIN, BB_SUID_DROP, md5sum))
 //applet:IF_SHA1SUM(APPLET_NOEXEC(sha1sum, md5_sha1_sum, BB_DIR_USR_BIN, BB_SUID_DROP, sha1sum))
@@ -61,7 +69,7 @@
 //kbuild:lib-$(CONFIG_SHA3SUM)   += md5_sha1_sum.o
 
 //usage:#define md5sum_trivial_usage
-//usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK("[-c[sw]] ")"[FILE]..."
+//usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK("[-c[sw]] ")IF_FEATURE_MD5_SHA1_SUM_PARALLEL("[-j N] ")"[FILE]..."
 //usage:#define md5sum_full_usage "\n\n"
 //usage:       "Print" IF_FEATURE_MD5_SHA1_SUM_CHECK(" or check") " MD5 checksums"
 //usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK( "\n"
@@ -69,6 +77,9 @@
 //usage:     "\n	-s	Don't output anything, status code shows success"
 //usage:     "\n	-w	Warn about improperly formatted checksum lines"
 //usage:	)
+//usage:	IF_FEATURE_MD5_SHA1_SUM_PARALLEL(
+//usage:     "\n	-j N	Hash N files at once"
+//usage:	)
 //usage:
 //usage:#define md5sum_example_usage
 //usage:       "$ md5sum < busybox\n"
@@ -81,7 +92,7 @@
 //usage:       "^D\n"
 //usage:
 //usage:#define sha1sum_trivial_usage
-//usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK("[-c[sw]] ")"[FILE]..."
+//usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK("[-c[sw]] ")IF_FEATURE_MD5_SHA1_SUM_PARALLEL("[-j N] ")"[FILE]..."
 //usage:#define sha1sum_full_usage "\n\n"
 //usage:       "Print" IF_FEATURE_MD5_SHA1_SUM_CHECK(" or check") " SHA1 checksums"
 //usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK( "\n"
@@ -89,9 +100,12 @@
 //usage:     "\n	-s	Don't output anything, status code shows success"
 //usage:     "\n	-w	Warn about improperly formatted checksum lines"
 //usage:	)
+//usage:	IF_FEATURE_MD5_SHA1_SUM_PARALLEL(
+//usage:     "\n	-j N	Hash N files at once"
+//usage:	)
 //usage:
 //usage:#define sha256sum_trivial_usage
-//usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK("[-c[sw]] ")"[FILE]..."
+//usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK("[-c[sw]] ")IF_FEATURE_MD5_SHA1_SUM_PARALLEL("[-j N] ")"[FILE]..."
 //usage:#define sha256sum_full_usage "\n\n"
 //usage:       "Print" IF_FEATURE_MD5_SHA1_SUM_CHECK(" or check") " SHA256 checksums"
 //usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK( "\n"
@@ -99,9 +113,12 @@
 //usage:     "\n	-s	Don't output anything, status code shows success"
 //usage:     "\n	-w	Warn about improperly formatted checksum lines"
 //usage:	)
+//usage:	IF_FEATURE_MD5_SHA1_SUM_PARALLEL(
+//usage:     "\n	-j N	Hash N files at once"
+//usage:	)
 //usage:
 //usage:#define sha512sum_trivial_usage
-//usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK("[-c[sw]] ")"[FILE]..."
+//usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK("[-c[sw]] ")IF_FEATURE_MD5_SHA1_SUM_PARALLEL("[-j N] ")"[FILE]..."
 //usage:#define sha512sum_full_usage "\n\n"
 //usage:       "Print" IF_FEATURE_MD5_SHA1_SUM_CHECK(" or check") " SHA512 checksums"
 //usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK( "\n"
@@ -109,9 +126,12 @@
 //usage:     "\n	-s	Don't output anything, status code shows success"
 //usage:     "\n	-w	Warn about improperly formatted checksum lines"
 //usage:	)
+//usage:	IF_FEATURE_MD5_SHA1_SUM_PARALLEL(
+//usage:     "\n	-j N	Hash N files at once"
+//usage:	)
 //usage:
 //usage:#define sha3sum_trivial_usage
-//usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK("[-c[sw]] ")"[-a BITS] [FILE]..."
+//usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK("[-c[sw]] ")IF_FEATURE_MD5_SHA1_SUM_PARALLEL("[-j N] ")"[-a BITS] [FILE]..."
 //usage:#define sha3sum_full_usage "\n\n"
 //usage:       "Print" IF_FEATURE_MD5_SHA1_SUM_CHECK(" or check") " SHA3 checksums"
 //usage:	IF_FEATURE_MD5_SHA1_SUM_CHECK( "\n"
@@ -120,6 +140,9 @@
 //usage:     "\n	-w	Warn about improperly formatted checksum lines"
 //usage:     "\n	-a BITS	224 (default), 256, 384, 512"
 //usage:	)
+//usage:	IF_FEATURE_MD5_SHA1_SUM_PARALLEL(
+//usage:     "\n	-j N	Hash N files at once"
+//usage:	)
 
 //FIXME: GNU coreutils 8.25 has no -s option, it has only these two long opts:
 // --quiet   don't print OK for each successfully verified file
@@ -153,9 +176,11 @@ static unsigned char *hash_bin_to_hex(unsigned char *hash_value,
 }
 
 #if !ENABLE_SHA3SUM
-# define hash_file(f,w) hash_file(f)
+# define hash_file(f,w,e) hash_file(f,e)
 #endif
-static uint8_t *hash_file(const char *filename, unsigned sha3_width)
+/* If fail is not NULL, errors are not printed: *fail is set
+ * to 'o' (can't open) or 'r' (can't read) and errno says why */
+static uint8_t *hash_file(const char *filename, unsigned sha3_width, char *fail)
 {
 	int src_fd, hash_len, count;
 	union _ctx_ {
@@ -170,8 +195,16 @@ static uint8_t *hash_file(const char *filename, unsigned sha3_width)
 	void FAST_FUNC (*final)(void*, void*);
 	char hash_algo;
 
-	src_fd = open_or_warn_stdin(filename);
+	if (fail) {
+		src_fd = STDIN_FILENO;
+		if (NOT_LONE_DASH(filename))
+			src_fd = open(filename, O_RDONLY);
+	} else {
+		src_fd = open_or_warn_stdin(filename);
+	}
 	if (src_fd < 0) {
+		if (fail)
+			*fail = 'o';
 		return NULL;
 	}
 
@@ -233,9 +266,12 @@ static uint8_t *hash_file(const char *filename, unsigned sha3_width)
 			update(&context, in_buf, count);
 		}
 		hash_value = NULL;
-		if (count < 0)
-			bb_perror_msg("can't read '%s'", filename);
-		else /* count == 0 */ {
+		if (count < 0) {
+			if (fail)
+				*fail = 'r';
+			else
+				bb_perror_msg("can't read '%s'", filename);
+		} else /* count == 0 */ {
 			final(&context, in_buf);
 			hash_value = hash_bin_to_hex(in_buf, hash_len);
 		}
@@ -243,12 +279,120 @@ static uint8_t *hash_file(const char *filename, unsigned sha3_width)
 	}
 
 	if (src_fd != STDIN_FILENO) {
+		int err = errno;
 		close(src_fd);
+		errno = err;
 	}
 
 	return hash_value;
 }
 
+#if ENABLE_FEATURE_MD5_SHA1_SUM_PARALLEL
+struct hash_workers {
+	unsigned jobs;
+	pid_t *pid;
+	FILE **res;
+};
+
+# if !ENABLE_SHA3SUM
+#  define start_hash_workers(n,c,j,w) start_hash_workers(n,c,j)
+# endif
+/* Fork "jobs" workers to hash names[0..cnt-1], NULL names are skipped.
+ * Worker k takes names k, k+jobs, k+2*jobs... and reports
+ * a line with hex hash for each, or "o<errno>" / "r<errno>"
+ * if it can't open / read it: we print errors in order.
+ */
+static struct hash_workers *start_hash_workers(char **names, unsigned cnt,
+		unsigned jobs, unsigned sha3_width)
+{
+	struct hash_workers *w;
+	unsigned k;
+
+	w = xmalloc(sizeof(*w));
+	w->jobs = jobs;
+	w->pid = xmalloc(jobs * sizeof(w->pid[0]));
+	w->res = xmalloc(jobs * sizeof(w->res[0]));
+	fflush_all();
+	for (k = 0; k < jobs; k++) {
+		int fd[2];
+
+		xpipe(fd);
+		w->pid[k] = xfork();
+		if (w->pid[k] == 0) {
+			unsigned i;
+
+			close(fd[0]);
+			xmove_fd(fd[1], STDOUT_FILENO);
+			for (i = k; i < cnt; i += jobs) {
+				uint8_t *hash_value;
+				char fail;
+
+				if (!names[i])
+					continue;
+				hash_value = hash_file(names[i], sha3_width, &fail);
+				if (hash_value)
+					printf("%s\n", hash_value);
+				else
+					printf("%c%d\n", fail, errno);
+				free(hash_value);
+			}
+			fflush_stdout_and_exit(EXIT_SUCCESS);
+		}
+		close(fd[1]);
+		w->res[k] = xfdopen_for_read(fd[0]);
+	}
+	return w;
+}
+
+/* Result for names[idx], in the same form as hash_file() returns */
+static uint8_t *next_hash(struct hash_workers *w, unsigned idx, const char *filename)
+{
+	char *hash_value = xmalloc_fgetline(w->res[idx % w->jobs]);
+
+	if (!hash_value)
+		bb_error_msg_and_die("worker died");
+	if (hash_value[0] == 'o' || hash_value[0] == 'r') {
+		errno = atoi(hash_value + 1);
+		bb_perror_msg(hash_value[0] == 'o' ? "can't open '%s'" : "can't read '%s'",
+				filename);
+		free(hash_value);
+		hash_value = NULL;
+	}
+	return (uint8_t*)hash_value;
+}
+
+static void stop_hash_workers(struct hash_workers *w)
+{
+	unsigned k;
+
+	for (k = 0; k < w->jobs; k++) {
+		fclose(w->res[k]);
+		safe_waitpid(w->pid[k], NULL, 0);
+	}
+	free(w->res);
+	free(w->pid);
+	free(w);
+}
+#endif
+
+/* Split "HASH  FILENAME" (or "HASH *FILENAME") line,
+ * return pointer to FILENAME or NULL if format is bad */
+static char *split_check_line(char *line)
+{
+	char *filename_ptr;
+
+	filename_ptr = strstr(line, "  ");
+	/* handle format for binary checksums */
+	if (filename_ptr == NULL) {
+		filename_ptr = strstr(line, " *");
+	}
+	if (filename_ptr != NULL) {
+		*filename_ptr = '\0';
+		filename_ptr += 2;
+	}
+	return filename_ptr;
+}
+
 int md5_sha1_sum_main(int argc, char **argv) MAIN_EXTERNALLY_VISIBLE;
 int md5_sha1_sum_main(int argc UNUSED_PARAM, char **argv)
 {
@@ -257,6 +401,11 @@ int md5_sha1_sum_main(int argc UNUSED_PARAM, char **argv)
 #if ENABLE_SHA3SUM
 	unsigned sha3_width = 224;
 #endif
+#if ENABLE_FEATURE_MD5_SHA1_SUM_PARALLEL
+	unsigned jobs = 1;
+	struct hash_workers *workers = NULL;
+	unsigned idx = 0;
+#endif
 
 	if (ENABLE_FEATURE_MD5_SHA1_SUM_CHECK) {
 		/* -s and -w require -c */
@@ -264,22 +413,34 @@ int md5_sha1_sum_main(int argc UNUSED_PARAM, char **argv)
 		/* -b "binary", -t "text" are ignored (shaNNNsum compat) */
 #if ENABLE_SHA3SUM
 		if (applet_name[3] == HASH_SHA3)
-			flags = getopt32(argv, "scwbta:+", &sha3_width);
+			flags = getopt32(argv, "scwbta:+" IF_FEATURE_MD5_SHA1_SUM_PARALLEL("j:+"),
+					&sha3_width IF_FEATURE_MD5_SHA1_SUM_PARALLEL(, &jobs));
 		else
 #endif
-			flags = getopt32(argv, "scwbt");
+			flags = getopt32(argv, "scwbt" IF_FEATURE_MD5_SHA1_SUM_PARALLEL("j:+")
+					IF_FEATURE_MD5_SHA1_SUM_PARALLEL(, &jobs));
 	} else {
 #if ENABLE_SHA3SUM
 		if (applet_name[3] == HASH_SHA3)
-			getopt32(argv, "a:+", &sha3_width);
+			getopt32(argv, "a:+" IF_FEATURE_MD5_SHA1_SUM_PARALLEL("j:+"),
+					&sha3_width IF_FEATURE_MD5_SHA1_SUM_PARALLEL(, &jobs));
 		else
 #endif
-			getopt32(argv, "");
+			getopt32(argv, "" IF_FEATURE_MD5_SHA1_SUM_PARALLEL("j:+")
+					IF_FEATURE_MD5_SHA1_SUM_PARALLEL(, &jobs));
 	}
 	argv += optind;
 	//argc -= optind;
 	if (!*argv)
 		*--argv = (char*)"-";
+#if ENABLE_FEATURE_MD5_SHA1_SUM_PARALLEL
+	if (jobs > 1 && !(ENABLE_FEATURE_MD5_SHA1_SUM_CHECK && (flags & FLAG_CHECK))) {
+		unsigned cnt = 0;
+		while (argv[cnt])
+			cnt++;
+		workers = start_hash_workers(argv, cnt, jobs, sha3_width);
+	}
+#endif
 
 	do {
 		if (ENABLE_FEATURE_MD5_SHA1_SUM_CHECK && (flags & FLAG_CHECK)) {
@@ -287,19 +448,47 @@ int md5_sha1_sum_main(int argc UNUSED_PARAM, char **argv)
 			char *line;
 			int count_total = 0;
 			int count_failed = 0;
+#if ENABLE_FEATURE_MD5_SHA1_SUM_PARALLEL
+			char **lines = NULL;
+			char **names = NULL;
+			unsigned nlines = 0;
+#endif
 
 			pre_computed_stream = xfopen_stdin(*argv);
 
-			while ((line = xmalloc_fgetline(pre_computed_stream)) != NULL) {
+#if ENABLE_FEATURE_MD5_SHA1_SUM_PARALLEL
+			if (jobs > 1) {
+				/* Workers need to know all names beforehand */
+				while ((line = xmalloc_fgetline(pre_computed_stream)) != NULL) {
+					lines = xrealloc_vector(lines, 6, nlines);
+					names = xrealloc_vector(names, 6, nlines);
+					names[nlines] = split_check_line(line);
+					lines[nlines++] = line;
+				}
+				workers = start_hash_workers(names, nlines, jobs, sha3_width);
+				idx = 0;
+			}
+#endif
+			while (1) {
 				uint8_t *hash_value;
 				char *filename_ptr;
 
-				count_total++;
-				filename_ptr = strstr(line, "  ");
-				/* handle format for binary checksums */
-				if (filename_ptr == NULL) {
-					filename_ptr = strstr(line, " *");
+#if ENABLE_FEATURE_MD5_SHA1_SUM_PARALLEL
+				if (workers) {
+					if (idx == nlines)
+						break;
+					line = lines[idx];
+					filename_ptr = names[idx++];
+				} else
+#endif
+				{
+					line = xmalloc_fgetline(pre_computed_stream);
+					if (!line)
+						break;
+					filename_ptr = split_check_line(line);
 				}
+
+				count_total++;
 				if (filename_ptr == NULL) {
 					if (flags & FLAG_WARN) {
 						bb_error_msg("invalid format");
@@ -309,10 +498,13 @@ int md5_sha1_sum_main(int argc UNUSED_PARAM, char **argv)
 					free(line);
 					continue;
 				}
-				*filename_ptr = '\0';
-				filename_ptr += 2;
 
-				hash_value = hash_file(filename_ptr, sha3_width);
+#if ENABLE_FEATURE_MD5_SHA1_SUM_PARALLEL
+				if (workers)
+					hash_value = next_hash(workers, idx - 1, filename_ptr);
+				else
+#endif
+					hash_value = hash_file(filename_ptr, sha3_width, NULL);
 
 				if (hash_value && (strcmp((char*)hash_value, line) == 0)) {
 					if (!(flags & FLAG_SILENT))
@@ -340,8 +532,22 @@ int md5_sha1_sum_main(int argc UNUSED_PARAM, char **argv)
 				bb_error_msg("%s: no checksum lines found", *argv);
 			}
 			fclose_if_not_stdin(pre_computed_stream);
+#if ENABLE_FEATURE_MD5_SHA1_SUM_PARALLEL
+			if (workers) {
+				stop_hash_workers(workers);
+				workers = NULL;
+				free(names);
+				free(lines);
+			}
+#endif
 		} else {
-			uint8_t *hash_value = hash_file(*argv, sha3_width);
+			uint8_t *hash_value;
+#if ENABLE_FEATURE_MD5_SHA1_SUM_PARALLEL
+			if (workers)
+				hash_value = next_hash(workers, idx++, *argv);
+			else
+#endif
+				hash_value = hash_file(*argv, sha3_width, NULL);
 			if (hash_value == NULL) {
 				return_value = EXIT_FAILURE;
 			} else {
@@ -351,5 +557,9 @@ int md5_sha1_sum_main(int argc UNUSED_PARAM, char **argv)
 		}
 	} while (*++argv);
 
+#if ENABLE_FEATURE_MD5_SHA1_SUM_PARALLEL
+	if (workers)
+		stop_hash_workers(workers);
+#endif
 	return return_value;
 }
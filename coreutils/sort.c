@@ -28,6 +28,33 @@
 //config:
 //config:	  The SuSv3 sort standard is available at:
 //config:	  http://www.opengroup.org/onlinepubs/007904975/utilities/sort.html
+//config:
+//config:config FEATURE_SORT_KEY_CACHE
+//config:	bool "Extract sort keys only once per line"
+//config:	default y
+//config:	depends on FEATURE_SORT_BIG
+//config:	help
+//config:	  Speeds up sorting with -k, -n, -g, -M, -b, -d, -f or -i
+//config:	  by extracting (and converting to numbers) each line's keys
+//config:	  once instead of on every comparison. Uses some more memory.
+//config:
+//config:config FEATURE_SORT_EXTERNAL
+//config:	bool "Support -S SIZE and -T DIR (sort using temporary files)"
+//config:	default y
+//config:	depends on FEATURE_SORT_BIG && PLATFORM_POSIX
+//config:	help
+//config:	  With -S SIZE, sort keeps at most about SIZE bytes of input
+//config:	  in memory. Sorted chunks of input are written to temporary
+//config:	  files in -T DIR ($TMPDIR or /tmp by default) and merged
+//config:	  at the end.
+//config:
+//config:config FEATURE_SORT_PARALLEL
+//config:	bool "Support --parallel=N (sort using several processes)"
+//config:	default y
+//config:	depends on FEATURE_SORT_EXTERNAL && LONG_OPTS && !NOMMU
+//config:	help
+//config:	  With --parallel=N, sort splits its input into N slices
+//config:	  which are sorted by N child processes, and merges them.
 
 //applet:IF_SORT(APPLET_NOEXEC(sort, sort, BB_DIR_USR_BIN, BB_SUID_DROP, sort))
 
@@ -36,6 +63,7 @@
 //usage:#define sort_trivial_usage
 //usage:       "[-nru"
 //usage:	IF_FEATURE_SORT_BIG("gMcszbdfiokt] [-o FILE] [-k start[.offset][opts][,end[.offset][opts]] [-t CHAR")
+//usage:	IF_FEATURE_SORT_EXTERNAL("] [-S SIZE] [-T DIR")
 //usage:       "] [FILE]..."
 //usage:#define sort_full_usage "\n\n"
 //usage:       "Sort lines of text\n"
@@ -63,8 +91,14 @@
 //usage:	IF_FEATURE_SORT_BIG(
 //usage:     "\n	-z	Lines are terminated by NUL, not newline"
 ////usage:     "\n	-m	Ignored for GNU compatibility"
-////usage:     "\n	-S BUFSZ Ignored for GNU compatibility"
-////usage:     "\n	-T TMPDIR Ignored for GNU compatibility"
+//usage:	)
+//usage:	IF_FEATURE_SORT_EXTERNAL(
+//usage:     "\n	-S SIZE	Use at most SIZE (default unit: k) of memory for data,"
+//usage:     "\n		sort larger inputs using temporary files"
+//usage:     "\n	-T DIR	Directory for temporary files"
+//usage:	)
+//usage:	IF_FEATURE_SORT_PARALLEL(
+//usage:     "\n	--parallel=N	Sort using N processes"
 //usage:	)
 //usage:
 //usage:#define sort_example_usage
@@ -94,7 +128,8 @@
 */
 
 /* These are sort types */
-static const char OPT_STR[] ALIGN1 = "ngMucszbrdfimS:T:o:k:*t:";
+static const char OPT_STR[] ALIGN1 = "ngMucszbrdfimS:T:o:k:*t:"
+		IF_FEATURE_SORT_PARALLEL("\xff:+");
 enum {
 	FLAG_n  = 1,            /* Numeric sort */
 	FLAG_g  = 2,            /* Sort using strtod() */
@@ -111,11 +146,12 @@ enum {
 	FLAG_f  = 0x400,        /* Force uppercase */
 	FLAG_i  = 0x800,        /* Ignore !isprint() */
 	FLAG_m  = 0x1000,       /* ignored: merge already sorted files; do not sort */
-	FLAG_S  = 0x2000,       /* ignored: -S, --buffer-size=SIZE */
-	FLAG_T  = 0x4000,       /* ignored: -T, --temporary-directory=DIR */
+	FLAG_S  = 0x2000,       /* -S, --buffer-size=SIZE (ignored w/o FEATURE_SORT_EXTERNAL) */
+	FLAG_T  = 0x4000,       /* -T, --temporary-directory=DIR (ditto) */
 	FLAG_o  = 0x8000,
 	FLAG_k  = 0x10000,
 	FLAG_t  = 0x20000,
+	FLAG_parallel = 0x40000, /* --parallel=N */
 	FLAG_bb = 0x80000000,   /* Ignore trailing blanks  */
 };
 
@@ -242,6 +278,49 @@ static struct sort_key *add_key(void)
 #define GET_LINE(fp) xmalloc_fgetline(fp)
 #endif
 
+#if ENABLE_FEATURE_SORT_BIG
+/* -n, -g and -M keys are turned into a class and a number.
+ * Keys compare by class first: for -g, not numbers < NaN < numbers
+ * (infinities included), for -M, not months < months.
+ */
+enum { NOT_NUMBER, IS_NAN, IS_NUMBER };
+
+static int key2num(const char *str, int flags, double *num)
+{
+	switch (flags & (FLAG_n | FLAG_M | FLAG_g)) {
+	default:
+		bb_error_msg_and_die("unknown sort type");
+	case FLAG_g: {
+		char *end;
+		*num = strtod(str, &end);
+		if (end == str)
+			return NOT_NUMBER;
+		return (*num != *num) ? IS_NAN : IS_NUMBER;
+	}
+	case FLAG_M: {
+		struct tm thyme;
+		if (!strptime(str, "%b", &thyme))
+			return NOT_NUMBER;
+		*num = thyme.tm_mon;
+		return IS_NUMBER;
+	}
+	/* Full floating point version of -n */
+	case FLAG_n:
+		*num = atof(str);
+		return IS_NUMBER;
+	}
+}
+
+static int compare_nums(int cx, double dx, int cy, double dy)
+{
+	if (cx != cy)
+		return cx - cy;
+	if (cx != IS_NUMBER)
+		return 0;
+	return (dx > dy) - (dx < dy);
+}
+#endif
+
 /* Iterate through keys list and perform comparisons */
 static int compare_keys(const void *xarg, const void *yarg)
 {
@@ -265,9 +344,6 @@ static int compare_keys(const void *xarg, const void *yarg)
 #endif
 		/* Perform actual comparison */
 		switch (flags & (FLAG_n | FLAG_M | FLAG_g)) {
-		default:
-			bb_error_msg_and_die("unknown sort type");
-			break;
 		/* Ascii sort */
 		case 0:
 #if ENABLE_LOCALE_SUPPORT
@@ -277,53 +353,11 @@ static int compare_keys(const void *xarg, const void *yarg)
 #endif
 			break;
 #if ENABLE_FEATURE_SORT_BIG
-		case FLAG_g: {
-			char *xx, *yy;
-			double dx = strtod(x, &xx);
-			double dy = strtod(y, &yy);
-			/* not numbers < NaN < -infinity < numbers < +infinity) */
-			if (x == xx)
-				retval = (y == yy ? 0 : -1);
-			else if (y == yy)
-				retval = 1;
-			/* Check for isnan */
-			else if (dx != dx)
-				retval = (dy != dy) ? 0 : -1;
-			else if (dy != dy)
-				retval = 1;
-			/* Check for infinity.  Could underflow, but it avoids libm. */
-			else if (1.0 / dx == 0.0) {
-				if (dx < 0)
-					retval = (1.0 / dy == 0.0 && dy < 0) ? 0 : -1;
-				else
-					retval = (1.0 / dy == 0.0 && dy > 0) ? 0 : 1;
-			} else if (1.0 / dy == 0.0)
-				retval = (dy < 0) ? 1 : -1;
-			else
-				retval = (dx > dy) ? 1 : ((dx < dy) ? -1 : 0);
-			break;
-		}
-		case FLAG_M: {
-			struct tm thyme;
-			int dx;
-			char *xx, *yy;
-
-			xx = strptime(x, "%b", &thyme);
-			dx = thyme.tm_mon;
-			yy = strptime(y, "%b", &thyme);
-			if (!xx)
-				retval = (!yy) ? 0 : -1;
-			else if (!yy)
-				retval = 1;
-			else
-				retval = dx - thyme.tm_mon;
-			break;
-		}
-		/* Full floating point version of -n */
-		case FLAG_n: {
-			double dx = atof(x);
-			double dy = atof(y);
-			retval = (dx > dy) ? 1 : ((dx < dy) ? -1 : 0);
+		default: {
+			double dx, dy;
+			int cx = key2num(x, flags, &dx);
+			int cy = key2num(y, flags, &dy);
+			retval = compare_nums(cx, dx, cy, dy);
 			break;
 		}
 		} /* switch */
@@ -332,6 +366,9 @@ static int compare_keys(const void *xarg, const void *yarg)
 		if (y != *(char **)yarg) free(y);
 		/* if (retval) break; - done by for () anyway */
 #else
+		default:
+			bb_error_msg_and_die("unknown sort type");
+			break;
 		/* Integer version of -n for tiny systems */
 		case FLAG_n:
 			retval = atoi(x) - atoi(y);
@@ -352,6 +389,366 @@ static int compare_keys(const void *xarg, const void *yarg)
 	return retval;
 }
 
+#if ENABLE_FEATURE_SORT_KEY_CACHE
+/* qsort() calls the compare function O(n log n) times, and for -k
+ * each call would extract (and for -dfi, copy) keys again. Instead,
+ * extract every key once per line and sort records holding the results.
+ * This is a copy of compare_keys() which uses them.
+ */
+struct key_cache {
+	union {
+		char *str;  /* text keys: key as returned by get_key() */
+		double num; /* -ngM keys: see key2num() */
+	} u;
+	int class;
+};
+struct sort_rec {
+	char *line;
+	struct key_cache key[];
+};
+static unsigned cached_keys; /* 0: keys are whole lines, don't bother */
+
+static int compare_recs(const void *xarg, const void *yarg)
+{
+	const struct sort_rec *xr = xarg;
+	const struct sort_rec *yr = yarg;
+	const struct key_cache *x = xr->key;
+	const struct key_cache *y = yr->key;
+	struct sort_key *key;
+	int flags = option_mask32, retval = 0;
+
+	for (key = key_list; !retval && key; key = key->next_key, x++, y++) {
+		flags = key->flags ? key->flags : option_mask32;
+		if (flags & (FLAG_n | FLAG_M | FLAG_g))
+			retval = compare_nums(x->class, x->u.num, y->class, y->u.num);
+		else
+#if ENABLE_LOCALE_SUPPORT
+			retval = strcoll(x->u.str, y->u.str);
+#else
+			retval = strcmp(x->u.str, y->u.str);
+#endif
+	}
+
+	/* Perform fallback sort if necessary */
+	if (!retval && !(option_mask32 & FLAG_s)) {
+		flags = option_mask32;
+		retval = strcmp(xr->line, yr->line);
+	}
+
+	if (flags & FLAG_r)
+		return -retval;
+
+	return retval;
+}
+
+static void init_key_cache(void)
+{
+	struct sort_key *key;
+	unsigned n = 0;
+	int trivial = 1;
+
+	for (key = key_list; key; key = key->next_key) {
+		int flags = key->flags ? key->flags : option_mask32;
+		if (n || key->range[0] != 1 || key->range[1]
+		 || key->range[2] || key->range[3]
+		 || (flags & (FLAG_n|FLAG_g|FLAG_M|FLAG_b|FLAG_d|FLAG_f|FLAG_i|FLAG_bb))
+		) {
+			trivial = 0;
+		}
+		n++;
+	}
+	cached_keys = trivial ? 0 : n;
+}
+
+static void sort_lines(char **lines, int linecount)
+{
+	size_t rec_size = sizeof(struct sort_rec) + cached_keys * sizeof(struct key_cache);
+	char *recs, *p;
+	int i;
+
+	if (!cached_keys) {
+		qsort(lines, linecount, sizeof(lines[0]), compare_keys);
+		return;
+	}
+
+	p = recs = xmalloc(linecount * rec_size);
+	for (i = 0; i < linecount; i++, p += rec_size) {
+		struct sort_rec *rec = (void*)p;
+		struct key_cache *kc = rec->key;
+		struct sort_key *key;
+
+		rec->line = lines[i];
+		for (key = key_list; key; key = key->next_key, kc++) {
+			int flags = key->flags ? key->flags : option_mask32;
+			char *str = get_key(rec->line, key, flags);
+
+			if (flags & (FLAG_n | FLAG_M | FLAG_g)) {
+				kc->class = key2num(str, flags, &kc->u.num);
+				if (str != rec->line)
+					free(str);
+			} else
+				kc->u.str = str;
+		}
+	}
+
+	qsort(recs, linecount, rec_size, compare_recs);
+
+	p = recs;
+	for (i = 0; i < linecount; i++, p += rec_size) {
+		struct sort_rec *rec = (void*)p;
+		struct key_cache *kc = rec->key;
+		struct sort_key *key;
+
+		lines[i] = rec->line;
+		for (key = key_list; key; key = key->next_key, kc++) {
+			int flags = key->flags ? key->flags : option_mask32;
+			if (!(flags & (FLAG_n | FLAG_M | FLAG_g))
+			 && kc->u.str != rec->line
+			) {
+				free(kc->u.str);
+			}
+		}
+	}
+	free(recs);
+}
+#else
+static void sort_lines(char **lines, int linecount)
+{
+	qsort(lines, linecount, sizeof(lines[0]), compare_keys);
+}
+#endif
+
+#if ENABLE_FEATURE_SORT_EXTERNAL
+/* With -S SIZE, input is read in chunks of about SIZE bytes.
+ * Each chunk is sorted and written to a temporary file ("run").
+ * At the end, runs are merged. If there are too many runs,
+ * they are merged into one before the next one is added.
+ */
+#define MAX_RUNS 32
+static const char *tmp_dir;
+static FILE *runs[MAX_RUNS];
+static unsigned nruns;
+
+struct merge_item {
+	char *line;
+	unsigned run;
+};
+
+static FILE *xtmpfile_in_dir(void)
+{
+	char *name = concat_path_file(tmp_dir, "sortXXXXXX");
+	int fd = xmkstemp(name);
+	FILE *fp;
+
+	/* Nobody else needs it, and it vanishes if we die */
+	unlink(name);
+	free(name);
+	fp = fdopen(fd, "w+");
+	if (!fp)
+		bb_perror_msg_and_die("fdopen");
+	return fp;
+}
+
+static void write_line(FILE *fp, const char *line)
+{
+	fprintf(fp, "%s%c", line, (option_mask32 & FLAG_z) ? '\0' : '\n');
+}
+
+/* Ties are resolved in favor of the earlier run, this keeps -s stable */
+static int merge_cmp(struct merge_item *x, struct merge_item *y)
+{
+	int retval = compare_keys(&x->line, &y->line);
+	if (retval == 0)
+		retval = x->run - y->run;
+	return retval;
+}
+
+static void sift_down(struct merge_item *heap, unsigned n, unsigned i)
+{
+	for (;;) {
+		struct merge_item t;
+		unsigned c = 2*i + 1;
+
+		if (c >= n)
+			break;
+		if (c + 1 < n && merge_cmp(&heap[c + 1], &heap[c]) < 0)
+			c++;
+		if (merge_cmp(&heap[i], &heap[c]) <= 0)
+			break;
+		t = heap[i];
+		heap[i] = heap[c];
+		heap[c] = t;
+		i = c;
+	}
+}
+
+/* Merge all runs into out (and close them). With uniq, lines whose keys
+ * are equal to the previous line's are dropped, as -u does */
+static void merge_runs(FILE *out, int uniq)
+{
+	struct merge_item heap[MAX_RUNS];
+	char *prev = NULL;
+	unsigned n, i;
+
+	n = 0;
+	for (i = 0; i < nruns; i++) {
+		char *line;
+
+		line = GET_LINE(runs[i]);
+		if (!line) {
+			fclose(runs[i]);
+			continue;
+		}
+		heap[n].line = line;
+		heap[n].run = i;
+		n++;
+	}
+	i = n / 2;
+	while (i-- != 0)
+		sift_down(heap, n, i);
+
+	while (n != 0) {
+		char *line = heap[0].line;
+		FILE *fp = runs[heap[0].run];
+
+		if (uniq && prev) {
+			unsigned opts = option_mask32;
+			int same;
+
+			/* See -u handling in sort_main */
+			option_mask32 |= FLAG_s;
+			same = (compare_keys(&prev, &line) == 0);
+			option_mask32 = opts;
+			if (same) {
+				free(line);
+				goto next;
+			}
+		}
+		write_line(out, line);
+		free(prev);
+		prev = line;
+		if (!uniq) {
+			free(line);
+			prev = NULL;
+		}
+ next:
+		heap[0].line = GET_LINE(fp);
+		if (!heap[0].line) {
+			fclose(fp);
+			heap[0] = heap[--n];
+		}
+		sift_down(heap, n, 0);
+	}
+	free(prev);
+	nruns = 0;
+}
+
+/* Make a completely written temp file ready for merge_runs */
+static void add_run(FILE *fp)
+{
+	if (fflush(fp) != 0)
+		bb_perror_msg_and_die(bb_msg_write_error);
+	if (fseeko(fp, 0, SEEK_SET) != 0)
+		bb_perror_msg_and_die("can't rewind temp file");
+	runs[nruns++] = fp;
+}
+
+#if ENABLE_FEATURE_SORT_PARALLEL
+/* With --parallel=N, lines[] is split into N slices. Each slice is
+ * sorted by a child process which writes it out as a run, either to
+ * a pipe (merged while children are still running) or to a temp file.
+ * Slices are in input order, so merge_cmp keeps -s stable.
+ */
+static unsigned sort_jobs;
+static unsigned nworkers;
+static pid_t workers[MAX_RUNS];
+
+static void sort_in_workers(char **lines, int linecount, int to_tmp)
+{
+	int start = 0;
+	unsigned j;
+
+	for (j = 0; j < sort_jobs; j++) {
+		int end = (unsigned long long)linecount * (j + 1) / sort_jobs;
+		struct fd_pair fds;
+		FILE *fp = fp; /* for compiler */
+		pid_t pid;
+
+		if (to_tmp)
+			fp = xtmpfile_in_dir();
+		else
+			xpiped_pair(fds);
+		pid = xfork();
+		if (pid == 0) {
+			/* child */
+			if (!to_tmp) {
+				close(fds.rd);
+				fp = xfdopen_for_write(fds.wr);
+			}
+			sort_lines(lines + start, end - start);
+			while (start < end)
+				write_line(fp, lines[start++]);
+			if (fflush(fp) != 0)
+				bb_perror_msg_and_die(bb_msg_write_error);
+			_exit(EXIT_SUCCESS);
+		}
+		workers[nworkers++] = pid;
+		if (!to_tmp) {
+			close(fds.wr);
+			fp = xfdopen_for_read(fds.rd);
+		}
+		runs[nruns++] = fp;
+		start = end;
+	}
+}
+
+static void wait_sort_workers(void)
+{
+	while (nworkers != 0) {
+		/* The child has already said what went wrong */
+		if (wait4pid(workers[--nworkers]) != 0)
+			xfunc_die();
+	}
+}
+#else
+enum { sort_jobs = 1 };
+#endif
+
+static void write_run(char **lines, int linecount)
+{
+	FILE *fp;
+	int i;
+
+	if (nruns + sort_jobs > MAX_RUNS) {
+		fp = xtmpfile_in_dir();
+		merge_runs(fp, /*uniq:*/ 0);
+		add_run(fp);
+	}
+#if ENABLE_FEATURE_SORT_PARALLEL
+	if (sort_jobs > 1) {
+		unsigned first = nruns;
+
+		sort_in_workers(lines, linecount, /*to_tmp:*/ 1);
+		wait_sort_workers();
+		/* Children wrote via their own FILEs, ours are still empty */
+		nruns = first;
+		while (nruns < first + sort_jobs)
+			add_run(runs[nruns]);
+		for (i = 0; i < linecount; i++)
+			free(lines[i]);
+		return;
+	}
+#endif
+	sort_lines(lines, linecount);
+	fp = xtmpfile_in_dir();
+	for (i = 0; i < linecount; i++) {
+		write_line(fp, lines[i]);
+		free(lines[i]);
+	}
+	add_run(fp);
+}
+#endif
+
 #if ENABLE_FEATURE_SORT_BIG
 static unsigned str2u(char **str)
 {
@@ -369,18 +766,29 @@ int sort_main(int argc, char **argv) MAIN_EXTERNALLY_VISIBLE;
 int sort_main(int argc UNUSED_PARAM, char **argv)
 {
 	char *line, **lines;
-	char *str_ignored, *str_o, *str_t;
+	char *str_S, *str_T, *str_o, *str_t;
 	llist_t *lst_k = NULL;
 	int i;
 	int linecount;
 	unsigned opts;
+#if ENABLE_FEATURE_SORT_PARALLEL
+	static const char sort_longopts[] ALIGN1 =
+		"parallel\0" Required_argument "\xff"; /* no short equivalent */
+#endif
+#if ENABLE_FEATURE_SORT_EXTERNAL
+	unsigned long long buf_size = 0;
+	unsigned long long mem_used = 0;
+#endif
 
 	xfunc_error_retval = 2;
 
 	/* Parse command line options */
 	/* -o and -t can be given at most once */
 	opt_complementary = "o--o:t--t"; /* -t, -o: at most one of each */
-	opts = getopt32(argv, OPT_STR, &str_ignored, &str_ignored, &str_o, &lst_k, &str_t);
+	IF_FEATURE_SORT_PARALLEL(applet_long_options = sort_longopts;)
+	opts = getopt32(argv, OPT_STR, &str_S, &str_T, &str_o, &lst_k, &str_t
+			IF_FEATURE_SORT_PARALLEL(, &sort_jobs)
+	);
 	/* global b strips leading and trailing spaces */
 	if (opts & FLAG_b)
 		option_mask32 |= FLAG_bb;
@@ -442,6 +850,36 @@ int sort_main(int argc UNUSED_PARAM, char **argv)
 			}
 		}
 	}
+	/* If no key, perform alphabetic sort */
+	if (!key_list)
+		add_key()->range[0] = 1;
+	IF_FEATURE_SORT_KEY_CACHE(init_key_cache();)
+#endif
+#if ENABLE_FEATURE_SORT_EXTERNAL
+	if (opts & FLAG_S) {
+		static const struct suffix_mult sort_size_suffixes[] = {
+			{ "b", 1 },
+			{ "k", 1024 },
+			{ "K", 1024 },
+			{ "M", 1024*1024 },
+			{ "G", 1024*1024*1024 },
+			{ "", 0 }
+		};
+		buf_size = xatoull_sfx(str_S, sort_size_suffixes);
+		/* GNU compat: default unit is kilobyte */
+		if (isdigit(str_S[strlen(str_S) - 1]))
+			buf_size *= 1024;
+	}
+	tmp_dir = (opts & FLAG_T) ? str_T : getenv("TMPDIR");
+	if (!tmp_dir || !tmp_dir[0])
+		tmp_dir = "/tmp";
+#endif
+#if ENABLE_FEATURE_SORT_PARALLEL
+	if (!(opts & FLAG_parallel) || sort_jobs == 0)
+		sort_jobs = 1;
+	/* Leave room in runs[] for the result of an intermediate merge */
+	if (sort_jobs > MAX_RUNS - 1)
+		sort_jobs = MAX_RUNS - 1;
 #endif
 
 	/* Open input files and read data */
@@ -460,14 +898,22 @@ int sort_main(int argc UNUSED_PARAM, char **argv)
 				break;
 			lines = xrealloc_vector(lines, 6, linecount);
 			lines[linecount++] = line;
+#if ENABLE_FEATURE_SORT_EXTERNAL
+			if (buf_size && !(option_mask32 & FLAG_c)) {
+				/* Count malloc overhead too, roughly */
+				mem_used += strlen(line) + 1 + 3 * sizeof(line);
+				if (mem_used > buf_size) {
+					write_run(lines, linecount);
+					linecount = 0;
+					mem_used = 0;
+				}
+			}
+#endif
 		}
 		fclose_if_not_stdin(fp);
 	} while (*++argv);
 
 #if ENABLE_FEATURE_SORT_BIG
-	/* If no key, perform alphabetic sort */
-	if (!key_list)
-		add_key()->range[0] = 1;
 	/* Handle -c */
 	if (option_mask32 & FLAG_c) {
 		int j = (option_mask32 & FLAG_u) ? -1 : 0;
@@ -479,9 +925,28 @@ int sort_main(int argc UNUSED_PARAM, char **argv)
 		}
 		return EXIT_SUCCESS;
 	}
+#endif
+#if ENABLE_FEATURE_SORT_PARALLEL
+	if (sort_jobs > 1 && !nruns && linecount > 1) {
+		/* Everything fit in memory: merge straight from pipes */
+		sort_in_workers(lines, linecount, /*to_tmp:*/ 0);
+		linecount = 0;
+	}
+#endif
+#if ENABLE_FEATURE_SORT_EXTERNAL
+	if (nruns) {
+		/* Input did not fit: write out the rest and merge */
+		if (linecount)
+			write_run(lines, linecount);
+		if (option_mask32 & FLAG_o)
+			xmove_fd(xopen(str_o, O_WRONLY|O_CREAT|O_TRUNC), STDOUT_FILENO);
+		merge_runs(stdout, option_mask32 & FLAG_u);
+		IF_FEATURE_SORT_PARALLEL(wait_sort_workers();)
+		fflush_stdout_and_exit(EXIT_SUCCESS);
+	}
 #endif
 	/* Perform the actual sort */
-	qsort(lines, linecount, sizeof(lines[0]), compare_keys);
+	sort_lines(lines, linecount);
 
 	/* Handle -u */
 	if (option_mask32 & FLAG_u) {
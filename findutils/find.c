@@ -229,6 +229,17 @@
 //config:	help
 //config:	  Support the 'find -context' option for matching security context.
 //config:
+//config:config FEATURE_FIND_PARALLEL
+//config:	bool "Enable -j N: walk directories with N processes"
+//config:	default y
+//config:	depends on FIND && !NOMMU && PLATFORM_POSIX
+//config:	help
+//config:	  With -j N, subtrees are walked and their actions are run
+//config:	  by N worker processes. This helps on filesystems where every
+//config:	  stat or readdir has high latency (network, NVMe queues).
+//config:	  Output is in the same order as without -j, unless
+//config:	  -unordered is given.
+//config:
 //config:config FEATURE_FIND_LINKS
 //config:	bool "Enable -links: link count matching"
 //config:	default y
@@ -259,6 +270,10 @@
 //usage:	IF_FEATURE_FIND_DEPTH(
 //usage:     "\n	-depth		Act on directory *after* traversing it"
 //usage:	)
+//usage:	IF_FEATURE_FIND_PARALLEL(
+//usage:     "\n	-j N		Walk directories with N processes"
+//usage:     "\n	-unordered	With -j, print subtrees as soon as they are done"
+//usage:	)
 //usage:     "\n"
 //usage:     "\nActions:"
 //usage:	IF_FEATURE_FIND_PAREN(
@@ -331,6 +346,7 @@
 //usage:	)
 //usage:	IF_FEATURE_FIND_EXEC_PLUS(
 //usage:     "\n	-exec CMD ARG + Run CMD with {} replaced by list of file names"
+//usage:     "\n	-exec-jobs N	Run up to N -exec + commands at once"
 //usage:	)
 //usage:	IF_FEATURE_FIND_DELETE(
 //usage:     "\n	-delete		Delete current file/directory. Turns on -depth option"
@@ -405,6 +421,8 @@ IF_FEATURE_FIND_EXEC(   ACTS(exec,
 					char **filelist;
 					int filelist_idx;
 					int file_len;
+					int args_len; /* of exec_argv without {} */
+					int name_len; /* {} arg: besides file name */
 				)
 				))
 IF_FEATURE_FIND_GROUP(  ACTS(group, gid_t gid;))
@@ -420,7 +438,17 @@ struct globals {
 	smallint need_print;
 	smallint xdev_on;
 	recurse_flags_t recurse_flags;
-	IF_FEATURE_FIND_EXEC_PLUS(unsigned max_argv_len;)
+#if ENABLE_FEATURE_FIND_EXEC_PLUS
+	int max_argv_len;
+	smallint exec_failed;
+	unsigned exec_jobs;
+	unsigned exec_running;
+	pid_t *exec_pids;
+#endif
+#if ENABLE_FEATURE_FIND_PARALLEL
+	unsigned max_jobs;
+	smallint unordered;
+#endif
 } FIX_ALIASING;
 #define G (*(struct globals*)bb_common_bufsiz1)
 #define INIT_G() do { \
@@ -430,8 +458,9 @@ struct globals {
 	memset(&G, 0, sizeof(G)); \
 	IF_FEATURE_FIND_MAXDEPTH(G.minmaxdepth[1] = INT_MAX;) \
 	IF_FEATURE_FIND_EXEC_PLUS(G.max_argv_len = bb_arg_max() - 2048;) \
+	IF_FEATURE_FIND_EXEC_PLUS(G.exec_jobs = 1;) \
 	G.need_print = 1; \
-	G.recurse_flags = ACTION_RECURSE; \
+	G.recurse_flags = ACTION_RECURSE | ACTION_LAZY_STAT; \
 } while (0)
 
 /* Return values of ACTFs ('action functions') are a bit mask:
@@ -484,6 +513,27 @@ static int exec_actions(action ***appp, const char *fileName, const struct stat
 	return rc ^ TRUE; /* restore TRUE bit */
 }
 
+#if ENABLE_FEATURE_FIND_XDEV || ENABLE_FEATURE_FIND_PERM \
+ || ENABLE_FEATURE_FIND_MTIME || ENABLE_FEATURE_FIND_MMIN \
+ || ENABLE_FEATURE_FIND_NEWER || ENABLE_FEATURE_FIND_INUM \
+ || ENABLE_FEATURE_FIND_USER || ENABLE_FEATURE_FIND_GROUP \
+ || ENABLE_FEATURE_FIND_SIZE || ENABLE_FEATURE_FIND_LINKS
+/* We walk with ACTION_LAZY_STAT: unless readdir didn't know the type,
+ * statbuf has nothing but the file type (and st_nlink == 0).
+ * Predicates which need more stat the file on first use.
+ * (Lazy entries are never links we need to follow, lstat is right).
+ */
+static int full_stat(const char *fileName, const struct stat *statbuf)
+{
+	if (statbuf->st_nlink != 0)
+		return TRUE;
+	if (lstat(fileName, (struct stat *)statbuf) == 0)
+		return TRUE;
+	bb_simple_perror_msg(fileName);
+	return FALSE;
+}
+#endif
+
 #if !FNM_CASEFOLD
 static char *strcpy_upcase(char *dst, const char *src)
 {
@@ -586,6 +636,8 @@ ACTF(type)
 #if ENABLE_FEATURE_FIND_PERM
 ACTF(perm)
 {
+	if (!full_stat(fileName, statbuf))
+		return FALSE;
 	/* -perm [+/]mode: at least one of perm_mask bits are set */
 	if (ap->perm_char == '+' || ap->perm_char == '/')
 		return (statbuf->st_mode & ap->perm_mask) != 0;
@@ -599,8 +651,12 @@ ACTF(perm)
 #if ENABLE_FEATURE_FIND_MTIME
 ACTF(mtime)
 {
-	time_t file_age = time(NULL) - statbuf->st_mtime;
+	time_t file_age;
 	time_t mtime_secs = ap->mtime_days * 24*60*60;
+
+	if (!full_stat(fileName, statbuf))
+		return FALSE;
+	file_age = time(NULL) - statbuf->st_mtime;
 	if (ap->mtime_char == '+')
 		return file_age >= mtime_secs + 24*60*60;
 	if (ap->mtime_char == '-')
@@ -612,8 +668,12 @@ ACTF(mtime)
 #if ENABLE_FEATURE_FIND_MMIN
 ACTF(mmin)
 {
-	time_t file_age = time(NULL) - statbuf->st_mtime;
+	time_t file_age;
 	time_t mmin_secs = ap->mmin_mins * 60;
+
+	if (!full_stat(fileName, statbuf))
+		return FALSE;
+	file_age = time(NULL) - statbuf->st_mtime;
 	if (ap->mmin_char == '+')
 		return file_age >= mmin_secs + 60;
 	if (ap->mmin_char == '-')
@@ -625,16 +685,32 @@ ACTF(mmin)
 #if ENABLE_FEATURE_FIND_NEWER
 ACTF(newer)
 {
+	if (!full_stat(fileName, statbuf))
+		return FALSE;
 	return (ap->newer_mtime < statbuf->st_mtime);
 }
 #endif
 #if ENABLE_FEATURE_FIND_INUM
 ACTF(inum)
 {
+	if (!full_stat(fileName, statbuf))
+		return FALSE;
 	return (statbuf->st_ino == ap->inode_num);
 }
 #endif
 #if ENABLE_FEATURE_FIND_EXEC
+# if ENABLE_FEATURE_FIND_EXEC_PLUS
+/* -exec-jobs N: batches of "-exec +" run in the background.
+ * Wait for the oldest one (not any child: with -j, the workers
+ * are our children too) */
+static void wait_exec_batch(void)
+{
+	if (wait4pid(G.exec_pids[0]) != 0)
+		G.exec_failed = 1;
+	G.exec_running--;
+	memmove(G.exec_pids, G.exec_pids + 1, G.exec_running * sizeof(G.exec_pids[0]));
+}
+# endif
 static int do_exec(action_exec *ap, const char *fileName)
 {
 	int i, rc;
@@ -683,13 +759,32 @@ static int do_exec(action_exec *ap, const char *fileName)
 	if (ap->filelist) {
 		ap->filelist[0] = NULL;
 		ap->filelist_idx = 0;
-		ap->file_len = 0;
+		ap->file_len = ap->args_len;
+		if (G.exec_jobs > 1) {
+			/* Don't wait for it, unless all slots are busy */
+			pid_t pid;
+
+			if (G.exec_running >= G.exec_jobs)
+				wait_exec_batch();
+			pid = spawn(argv);
+			rc = -1;
+			if (pid > 0) {
+				G.exec_pids[G.exec_running++] = pid;
+				rc = 0;
+			}
+			goto spawned;
+		}
 	}
 # endif
 
 	rc = spawn_and_wait(argv);
+ IF_FEATURE_FIND_EXEC_PLUS(spawned:)
 	if (rc < 0)
 		bb_simple_perror_msg(argv[0]);
+# if ENABLE_FEATURE_FIND_EXEC_PLUS
+	if (ap->filelist && rc != 0)
+		G.exec_failed = 1;
+# endif
 
 	i = 0;
 	while (argv[i])
@@ -700,21 +795,24 @@ ACTF(exec)
 {
 # if ENABLE_FEATURE_FIND_EXEC_PLUS
 	if (ap->filelist) {
-		int rc;
+		int len = strlen(fileName) + ap->name_len;
 
+		/* Run what we have if this name doesn't fit anymore */
+		if (ap->filelist_idx != 0 && ap->file_len + len > G.max_argv_len)
+			do_exec(ap, NULL);
 		ap->filelist = xrealloc_vector(ap->filelist, 8, ap->filelist_idx);
 		ap->filelist[ap->filelist_idx++] = xstrdup(fileName);
-		ap->file_len += strlen(fileName) + sizeof(char*) + 1;
-		/* If we have lots of files already, exec the command */
-		rc = 1;
-		if (ap->file_len >= G.max_argv_len)
-			rc = do_exec(ap, NULL);
-		return rc;
+		ap->file_len += len;
+		/* Like in GNU find, "-exec +" is always true,
+		 * failed commands only make the exit code nonzero */
+		return TRUE;
 	}
 # endif
 	return do_exec(ap, fileName);
 }
 # if ENABLE_FEATURE_FIND_EXEC_PLUS
+/* Run the last batches, wait for all of them.
+ * Returns 1 if any "-exec +" command failed */
 static int flush_exec_plus(void)
 {
 	action *ap;
@@ -724,30 +822,55 @@ static int flush_exec_plus(void)
 		while ((ap = *app++) != NULL) {
 			if (ap->f == (action_fp)func_exec) {
 				action_exec *ae = (void*)ap;
-				if (ae->filelist_idx != 0) {
-					int rc = do_exec(ae, NULL);
-#  if ENABLE_FEATURE_FIND_NOT
-					if (ap->invert) rc = !rc;
-#  endif
-					if (rc == 0)
-						return 1;
+				if (ae->filelist_idx != 0)
+					do_exec(ae, NULL);
+			}
+		}
+	}
+	while (G.exec_running != 0)
+		wait_exec_batch();
+	return G.exec_failed;
+}
+#  if ENABLE_FEATURE_FIND_PARALLEL
+/* In a -j worker: names the parent collected so far
+ * are in its batches, not ours, and batches it started
+ * are its children, not ours */
+static void forget_exec_plus(void)
+{
+	action *ap;
+	action **app;
+	action ***appp = G.actions;
+	while ((app = *appp++) != NULL) {
+		while ((ap = *app++) != NULL) {
+			if (ap->f == (action_fp)func_exec) {
+				action_exec *ae = (void*)ap;
+				if (ae->filelist) {
+					while (ae->filelist_idx != 0)
+						free(ae->filelist[--ae->filelist_idx]);
+					ae->filelist[0] = NULL;
+					ae->file_len = ae->args_len;
 				}
 			}
 		}
 	}
-	return 0;
+	G.exec_running = 0;
 }
+#  endif
 # endif
 #endif
 #if ENABLE_FEATURE_FIND_USER
 ACTF(user)
 {
+	if (!full_stat(fileName, statbuf))
+		return FALSE;
 	return (statbuf->st_uid == ap->uid);
 }
 #endif
 #if ENABLE_FEATURE_FIND_GROUP
 ACTF(group)
 {
+	if (!full_stat(fileName, statbuf))
+		return FALSE;
 	return (statbuf->st_gid == ap->gid);
 }
 #endif
@@ -772,6 +895,8 @@ ACTF(paren)
 #if ENABLE_FEATURE_FIND_SIZE
 ACTF(size)
 {
+	if (!full_stat(fileName, statbuf))
+		return FALSE;
 	if (ap->size_char == '+')
 		return statbuf->st_size > ap->size;
 	if (ap->size_char == '-')
@@ -829,6 +954,8 @@ ACTF(context)
 #if ENABLE_FEATURE_FIND_LINKS
 ACTF(links)
 {
+	if (!full_stat(fileName, statbuf))
+		return FALSE;
 	switch(ap->links_char) {
 	case '-' : return (statbuf->st_nlink <  ap->links_count);
 	case '+' : return (statbuf->st_nlink >  ap->links_count);
@@ -846,7 +973,9 @@ static int FAST_FUNC fileAction(const char *fileName,
 	int same_fs = 1;
 
 #if ENABLE_FEATURE_FIND_XDEV
-	if (S_ISDIR(statbuf->st_mode) && G.xdev_count) {
+	if (S_ISDIR(statbuf->st_mode) && G.xdev_count
+	 && full_stat(fileName, statbuf)
+	) {
 		int i;
 		for (i = 0; i < G.xdev_count; i++) {
 			if (G.xdev_dev[i] == statbuf->st_dev)
@@ -890,6 +1019,400 @@ static int FAST_FUNC fileAction(const char *fileName,
 	return (r & SKIP) ? SKIP : TRUE;
 }
 
+#if ENABLE_FEATURE_FIND_PARALLEL
+/* -j N: the walk is cut into slots, in the order a serial walk
+ * visits them. Directories near the top are read by the parent,
+ * which also runs the actions on them (dir slots). What is below them
+ * (tree slots) is walked by N worker processes. Runs of tree slots
+ * make up jobs, workers pull job numbers from a pipe: whoever is done
+ * with a small subtree takes the next job.
+ * Every worker writes into its own unlinked temp file and reports
+ * file ranges of its jobs. The parent copies them to stdout in slot
+ * order, or as they come with -unordered.
+ */
+struct find_slot {
+	char *name;
+	struct stat *st;  /* NULL if not a directory */
+	int depth;
+	smallint is_tree;
+	smallint done;
+	int fd;           /* output is [start,end) of fd, if fd >= 0 */
+	off_t start, end;
+};
+
+struct find_job {
+	unsigned first, last;
+};
+
+struct find_result {
+	unsigned job;     /* ~0: worker exits (output of -exec {} +) */
+	int status;
+	int worker;
+	off_t start, end;
+};
+
+struct find_par {
+	struct find_slot *slots;
+	unsigned count;
+	struct find_job *jobs;
+	unsigned njobs;
+	int out_fd;       /* parent's output goes there, unless -1 */
+	int status;
+};
+
+/* Consecutive entries walked as one job */
+enum { FIND_JOB_SLOTS = 64 };
+
+static int find_tmpfile(void)
+{
+	const char *tmp_dir = getenv("TMPDIR");
+	char *name;
+	int fd;
+
+	if (!tmp_dir || !tmp_dir[0])
+		tmp_dir = "/tmp";
+	name = concat_path_file(tmp_dir, "findXXXXXX");
+	fd = xmkstemp(name);
+	unlink(name);
+	free(name);
+	return fd;
+}
+
+static void copy_range(int fd, off_t start, off_t end, char *buf)
+{
+	/* The file offset is shared with the writer, so pread */
+	while (start < end) {
+		size_t sz = MIN(end - start, COMMON_BUFSIZE);
+		ssize_t rd = pread(fd, buf, sz, start);
+		if (rd <= 0)
+			bb_perror_msg_and_die("read error");
+		xwrite(STDOUT_FILENO, buf, rd);
+		start += rd;
+	}
+}
+
+static struct find_slot *new_slot(struct find_par *p,
+		char *name, struct stat *st, int depth, int is_tree)
+{
+	struct find_slot *sl;
+
+	p->slots = xrealloc_vector(p->slots, 6, p->count);
+	sl = &p->slots[p->count++];
+	sl->name = name;
+	sl->st = st;
+	sl->depth = depth;
+	sl->is_tree = is_tree;
+	sl->fd = -1;
+	return sl;
+}
+
+static int dir_slot_action(struct find_par *p, struct find_slot *sl)
+{
+	int r;
+
+	sl->fd = p->out_fd;
+	if (sl->fd >= 0)
+		sl->start = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+	r = fileAction(sl->name, sl->st, NULL, sl->depth);
+	fflush_all();
+	if (sl->fd >= 0)
+		sl->end = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+	sl->done = 1;
+	return r;
+}
+
+/* Replace tree slot of a directory with a dir slot and its entries */
+static void expand_slot(struct find_par *p, struct find_slot *tree)
+{
+	unsigned follow = G.recurse_flags & ACTION_FOLLOWLINKS;
+	DIR *dir;
+	struct dirent *next;
+
+	if (!(G.recurse_flags & ACTION_DEPTHFIRST)) {
+		struct find_slot *sl = new_slot(p, tree->name, tree->st, tree->depth, 0);
+		if (dir_slot_action(p, sl) == SKIP)
+			return;
+	}
+	dir = opendir(tree->name);
+	if (!dir) {
+		bb_simple_perror_msg(tree->name);
+		p->status = EXIT_FAILURE;
+		/* recursive_action() doesn't run -depth actions on it either */
+		if (G.recurse_flags & ACTION_DEPTHFIRST) {
+			free(tree->name);
+			free(tree->st);
+		}
+		return;
+	}
+	while ((next = readdir(dir)) != NULL) {
+		struct stat *st = NULL;
+		unsigned type;
+		char *name;
+
+		if (DOT_OR_DOTDOT(next->d_name))
+			continue;
+		name = concat_path_file(tree->name, next->d_name);
+		type = dirent_type(next);
+		if (type == DT_UNKNOWN || (type == DT_LNK && follow)) {
+			struct stat sb;
+			if ((follow ? stat : lstat)(name, &sb) == 0
+			 && S_ISDIR(sb.st_mode)
+			) {
+				st = xmemdup(&sb, sizeof(sb));
+			}
+		} else if (type == DT_DIR) {
+			/* Lazy, like ACTION_LAZY_STAT does it */
+			st = xzalloc(sizeof(*st));
+			st->st_mode = S_IFDIR;
+		}
+		new_slot(p, name, st, tree->depth + 1, 1);
+	}
+	closedir(dir);
+	/* -depth: acted on when the slots above are done */
+	if (G.recurse_flags & ACTION_DEPTHFIRST)
+		new_slot(p, tree->name, tree->st, tree->depth, 0);
+}
+
+static void split_tree(struct find_par *p, unsigned nworkers)
+{
+	unsigned round;
+
+	/* Read directories breadth first until there is enough
+	 * subtrees for the workers to share */
+	for (round = 0; round < 8; round++) {
+		struct find_slot *old = p->slots;
+		unsigned count = p->count;
+		unsigned i, dirs = 0;
+
+		for (i = 0; i < count; i++)
+			if (old[i].is_tree && old[i].st)
+				dirs++;
+		if (dirs == 0 || dirs >= 4 * nworkers)
+			break;
+		p->slots = NULL;
+		p->count = 0;
+		for (i = 0; i < count; i++) {
+			if (old[i].is_tree && old[i].st)
+				expand_slot(p, &old[i]);
+			else
+				*new_slot(p, NULL, NULL, 0, 0) = old[i];
+		}
+		free(old);
+	}
+
+	/* A job ends after a directory, or at a dir slot */
+	for (round = 0; round < p->count;) {
+		unsigned first = round;
+
+		if (!p->slots[round++].is_tree)
+			continue;
+		while (round < p->count
+		 && p->slots[round].is_tree
+		 && !p->slots[round - 1].st
+		 && round - first < FIND_JOB_SLOTS
+		) {
+			round++;
+		}
+		p->jobs = xrealloc_vector(p->jobs, 6, p->njobs);
+		p->jobs[p->njobs].first = first;
+		p->jobs[p->njobs].last = round;
+		p->njobs++;
+	}
+}
+
+static void NORETURN find_worker(struct find_par *p, int job_fd, int res_fd, int worker)
+{
+	struct find_result res;
+	unsigned j;
+
+	IF_FEATURE_FIND_EXEC_PLUS(forget_exec_plus();)
+	res.worker = worker;
+	while (full_read(job_fd, &j, sizeof(j)) == sizeof(j)) {
+		unsigned i;
+
+		res.job = j;
+		res.status = TRUE;
+		res.start = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+		for (i = p->jobs[j].first; i < p->jobs[j].last; i++) {
+			struct find_slot *sl = &p->slots[i];
+			if (!recursive_action(sl->name,
+					G.recurse_flags,/* flags */
+					fileAction,     /* file action */
+					fileAction,     /* dir action */
+					NULL,           /* user data */
+					sl->depth)      /* depth */
+			) {
+				res.status = FALSE;
+			}
+		}
+		fflush_all();
+		res.end = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+		xwrite(res_fd, &res, sizeof(res));
+	}
+	res.job = ~0u;
+	res.status = TRUE;
+	res.start = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+	IF_FEATURE_FIND_EXEC_PLUS(res.status = !flush_exec_plus();)
+	fflush_all();
+	res.end = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+	xwrite(res_fd, &res, sizeof(res));
+	_exit(EXIT_SUCCESS);
+}
+
+/* Copy out finished slots, run -depth actions of dirs whose
+ * contents are done */
+static void flush_slots(struct find_par *p, unsigned *next, char *buf)
+{
+	while (*next < p->count) {
+		struct find_slot *sl = &p->slots[*next];
+
+		if (!sl->done) {
+			if (sl->is_tree)
+				break;
+			dir_slot_action(p, sl);
+		}
+		if (sl->fd >= 0)
+			copy_range(sl->fd, sl->start, sl->end, buf);
+		(*next)++;
+	}
+}
+
+static int find_parallel(char **argv)
+{
+	struct find_par par;
+	struct fd_pair job_pipe, res_pipe;
+	int saved_stdout = -1;
+	int dir_out;
+	int *out;
+	char *buf;
+	pid_t *pids;
+	unsigned nworkers, sent, left, next, i;
+
+	memset(&par, 0, sizeof(par));
+	par.out_fd = -1;
+	fflush_all();
+	if (!G.unordered) {
+		/* Collect what we print while reading top directories */
+		par.out_fd = find_tmpfile();
+		saved_stdout = dup(STDOUT_FILENO);
+		if (saved_stdout < 0)
+			bb_simple_perror_msg_and_die("dup");
+		xdup2(par.out_fd, STDOUT_FILENO);
+	}
+	for (i = 0; argv[i]; i++) {
+		struct stat sb, *st = NULL;
+		int r;
+
+		if (G.recurse_flags & (ACTION_FOLLOWLINKS | ACTION_FOLLOWLINKS_L0))
+			r = stat(argv[i], &sb);
+		else
+			r = lstat(argv[i], &sb);
+		/* Not a dir, or error: recursive_action() in a worker
+		 * will deal with it */
+		if (r == 0 && S_ISDIR(sb.st_mode))
+			st = xmemdup(&sb, sizeof(sb));
+		new_slot(&par, xstrdup(argv[i]), st, 0, 1);
+	}
+	split_tree(&par, G.max_jobs);
+	fflush_all();
+	if (saved_stdout >= 0) {
+		xdup2(saved_stdout, STDOUT_FILENO);
+		close(saved_stdout);
+	}
+	/* From now on, dir slots print directly */
+	dir_out = par.out_fd;
+	par.out_fd = -1;
+
+	nworkers = MIN(G.max_jobs, par.njobs);
+	out = xmalloc((nworkers + 1) * sizeof(out[0]));
+	pids = xmalloc((nworkers + 1) * sizeof(pids[0]));
+	xpiped_pair(job_pipe);
+	xpiped_pair(res_pipe);
+	for (i = 0; i < nworkers; i++) {
+		out[i] = find_tmpfile();
+		pids[i] = xfork();
+		if (pids[i] == 0) {
+			/* child */
+			close(job_pipe.wr);
+			close(res_pipe.rd);
+			xdup2(out[i], STDOUT_FILENO);
+			find_worker(&par, job_pipe.rd, res_pipe.wr, i);
+		}
+	}
+	close(job_pipe.rd);
+	close(res_pipe.wr);
+
+	/* Keep the job pipe short: results must not fill their pipe
+	 * while we are blocked writing jobs */
+	sent = 0;
+	while (sent < par.njobs && sent < 2 * nworkers) {
+		xwrite(job_pipe.wr, &sent, sizeof(sent));
+		sent++;
+	}
+	if (sent == par.njobs)
+		close(job_pipe.wr);
+
+	buf = xmalloc(COMMON_BUFSIZE);
+	next = 0;
+	flush_slots(&par, &next, buf);
+	left = par.njobs + nworkers;
+	while (left != 0) {
+		struct find_result res;
+		struct find_job *job;
+
+		if (full_read(res_pipe.rd, &res, sizeof(res)) != sizeof(res))
+			bb_error_msg_and_die("worker died");
+		left--;
+		if (!res.status)
+			par.status = EXIT_FAILURE;
+		if (res.job == ~0u) {
+			copy_range(out[res.worker], res.start, res.end, buf);
+			continue;
+		}
+		if (sent < par.njobs) {
+			xwrite(job_pipe.wr, &sent, sizeof(sent));
+			if (++sent == par.njobs)
+				close(job_pipe.wr);
+		}
+		job = &par.jobs[res.job];
+		for (i = job->first; i < job->last; i++)
+			par.slots[i].done = 1;
+		if (G.unordered) {
+			copy_range(out[res.worker], res.start, res.end, buf);
+		} else {
+			struct find_slot *sl = &par.slots[job->first];
+			sl->fd = out[res.worker];
+			sl->start = res.start;
+			sl->end = res.end;
+		}
+		flush_slots(&par, &next, buf);
+	}
+	/* No jobs at all: -depth actions of dirs are still pending */
+	flush_slots(&par, &next, buf);
+	close(res_pipe.rd);
+	/* Not wait(): "-exec-jobs" batches are our children too */
+	for (i = 0; i < nworkers; i++)
+		safe_waitpid(pids[i], NULL, 0);
+
+	if (ENABLE_FEATURE_CLEAN_UP) {
+		for (i = 0; i < par.count; i++) {
+			free(par.slots[i].name);
+			free(par.slots[i].st);
+		}
+		for (i = 0; i < nworkers; i++)
+			close(out[i]);
+		if (dir_out >= 0)
+			close(dir_out);
+		free(par.slots);
+		free(par.jobs);
+		free(out);
+		free(pids);
+		free(buf);
+	}
+	return par.status;
+}
+#endif
+
 
 #if ENABLE_FEATURE_FIND_TYPE
 static int find_type(const char *type)
@@ -960,6 +1483,7 @@ static action*** parse_params(char **argv)
 	                        OPT_FOLLOW     ,
 	IF_FEATURE_FIND_XDEV(   OPT_XDEV       ,)
 	IF_FEATURE_FIND_DEPTH(  OPT_DEPTH      ,)
+	IF_FEATURE_FIND_PARALLEL(OPT_UNORDERED ,)
 	                        PARM_a         ,
 	                        PARM_o         ,
 	IF_FEATURE_FIND_NOT(	PARM_char_not  ,)
@@ -997,12 +1521,15 @@ static action*** parse_params(char **argv)
 	IF_FEATURE_FIND_CONTEXT(PARM_context   ,)
 	IF_FEATURE_FIND_LINKS(  PARM_links     ,)
 	IF_FEATURE_FIND_MAXDEPTH(OPT_MINDEPTH,OPT_MAXDEPTH,)
+	IF_FEATURE_FIND_PARALLEL(OPT_JOBS      ,)
+	IF_FEATURE_FIND_EXEC_PLUS(OPT_EXEC_JOBS,)
 	};
 
 	static const char params[] ALIGN1 =
 	                        "-follow\0"
 	IF_FEATURE_FIND_XDEV(   "-xdev\0"                 )
 	IF_FEATURE_FIND_DEPTH(  "-depth\0"                )
+	IF_FEATURE_FIND_PARALLEL("-unordered\0"           )
 	                        "-a\0"
 	                        "-o\0"
 	IF_FEATURE_FIND_NOT(    "!\0"       )
@@ -1038,6 +1565,8 @@ static action*** parse_params(char **argv)
 	IF_FEATURE_FIND_CONTEXT("-context\0")
 	IF_FEATURE_FIND_LINKS(  "-links\0"  )
 	IF_FEATURE_FIND_MAXDEPTH("-mindepth\0""-maxdepth\0")
+	IF_FEATURE_FIND_PARALLEL("-j\0"    )
+	IF_FEATURE_FIND_EXEC_PLUS("-exec-jobs\0")
 	;
 
 #if !USE_NESTED_FUNCTION
@@ -1120,6 +1649,24 @@ static action*** parse_params(char **argv)
 			G.recurse_flags |= ACTION_DEPTHFIRST;
 		}
 #endif
+#if ENABLE_FEATURE_FIND_PARALLEL
+		else if (parm == OPT_JOBS) {
+			dbg("%d", __LINE__);
+			G.max_jobs = xatou_range(arg1, 1, 1024);
+		}
+		else if (parm == OPT_UNORDERED) {
+			dbg("%d", __LINE__);
+			G.unordered = 1;
+		}
+#endif
+#if ENABLE_FEATURE_FIND_EXEC_PLUS
+		else if (parm == OPT_EXEC_JOBS) {
+			dbg("%d", __LINE__);
+			G.exec_jobs = xatou_range(arg1, 1, 1024);
+			free(G.exec_pids);
+			G.exec_pids = xmalloc(G.exec_jobs * sizeof(G.exec_pids[0]));
+		}
+#endif
 /* Actions are grouped by operators
  * ( expr )              Force precedence
  * ! expr                True if expr is false
@@ -1220,6 +1767,16 @@ static action*** parse_params(char **argv)
 			 */
 			if (all_subst != 1 && ap->filelist)
 				bb_error_msg_and_die("only one '{}' allowed for -exec +");
+			/* What goes into the command line besides file names */
+			i = ap->exec_argc;
+			while (i--) {
+				int len = strlen(ap->exec_argv[i]) + 1 + sizeof(char*);
+				if (ap->subst_count[i])
+					ap->name_len = len - 2;
+				else
+					ap->args_len += len;
+			}
+			ap->file_len = ap->args_len;
 # endif
 		}
 #endif
@@ -1422,6 +1979,16 @@ int find_main(int argc UNUSED_PARAM, char **argv)
 	char **past_HLP, *saved;
 
 	INIT_G();
+#if ENABLE_FEATURE_FIND_EXEC_PLUS
+	{
+		/* The environment takes room from "-exec +" command lines */
+		char **e;
+		for (e = environ; *e; e++)
+			G.max_argv_len -= strlen(*e) + 1 + sizeof(*e);
+		if (G.max_argv_len < 4096)
+			G.max_argv_len = 4096;
+	}
+#endif
 
 	/* "find -type f" + getopt("+HLP") => disaster.
 	 * Need to avoid getopt running into a non-HLP option.
@@ -1484,6 +2051,14 @@ int find_main(int argc UNUSED_PARAM, char **argv)
 	}
 #endif
 
+#if ENABLE_FEATURE_FIND_PARALLEL
+	if (G.max_jobs > 1) {
+		status = find_parallel(argv);
+		IF_FEATURE_FIND_EXEC_PLUS(status |= flush_exec_plus();)
+		return status;
+	}
+#endif
+
 	for (i = 0; argv[i]; i++) {
 		if (!recursive_action(argv[i],
 				G.recurse_flags,/* flags */
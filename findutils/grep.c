@@ -44,6 +44,34 @@
 //config:	  Print the specified number of leading (-B) and/or trailing (-A)
 //config:	  context surrounding our matching lines.
 //config:	  Print the specified number of context lines (-C).
+//config:
+//config:config FEATURE_GREP_FAST_FIXED
+//config:	bool "Fast fixed string search (-F)"
+//config:	default y
+//config:	depends on GREP || EGREP || FGREP
+//config:	help
+//config:	  With -F, search for a single string with Boyer-Moore-Horspool,
+//config:	  and for several strings (e.g. -f FILE with many lines)
+//config:	  with an Aho-Corasick automaton which finds all of them
+//config:	  in one pass over the line.
+//config:
+//config:config FEATURE_GREP_BUFFERED
+//config:	bool "Read input in large blocks"
+//config:	default y
+//config:	depends on (GREP || EGREP || FGREP) && !EXTRA_COMPAT && PLATFORM_POSIX
+//config:	help
+//config:	  Read files in large blocks and split them into lines in place
+//config:	  instead of allocating every line. With -F, whole blocks are
+//config:	  searched at once and only lines with a possible match
+//config:	  are looked at.
+//config:
+//config:config FEATURE_GREP_PARALLEL
+//config:	bool "Enable -j N (search directories with N processes)"
+//config:	default y
+//config:	depends on (GREP || EGREP || FGREP) && !NOMMU && PLATFORM_POSIX
+//config:	help
+//config:	  With -r -j N, files found in directories are searched
+//config:	  by N worker processes. Output is the same as without -j.
 
 //applet:IF_GREP(APPLET(grep, BB_DIR_BIN, BB_SUID_DROP))
 //applet:IF_EGREP(APPLET_ODDNAME(egrep, grep, BB_DIR_BIN, BB_SUID_DROP, egrep))
@@ -64,6 +92,7 @@
 //usage:	IF_EXTRA_COMPAT("z")
 //usage:       "] [-m N] "
 //usage:	IF_FEATURE_GREP_CONTEXT("[-A/B/C N] ")
+//usage:	IF_FEATURE_GREP_PARALLEL("[-j N] ")
 //usage:       "PATTERN/-e PATTERN.../-f FILE [FILE]..."
 //usage:#define grep_full_usage "\n\n"
 //usage:       "Search for PATTERN in FILEs (or stdin)\n"
@@ -78,6 +107,9 @@
 //usage:     "\n	-v	Select non-matching lines"
 //usage:     "\n	-s	Suppress open and read errors"
 //usage:     "\n	-r	Recurse"
+//usage:	IF_FEATURE_GREP_PARALLEL(
+//usage:     "\n	-j N	Search files in directories using N processes"
+//usage:	)
 //usage:     "\n	-i	Ignore case"
 //usage:     "\n	-w	Match whole words only"
 //usage:     "\n	-x	Match whole lines only"
@@ -111,6 +143,7 @@
 	IF_FEATURE_GREP_CONTEXT("A:+B:+C:+") \
 	"E" \
 	IF_EXTRA_COMPAT("z") \
+	IF_FEATURE_GREP_PARALLEL("j:+") \
 	"aI"
 /* ignored: -a "assume all files to be text" */
 /* ignored: -I "assume binary files have no matches" */
@@ -138,6 +171,7 @@ enum {
 	IF_FEATURE_GREP_CONTEXT(    OPTBIT_C ,) /* -C NUM: -A and -B combined */
 	OPTBIT_E, /* extended regexp */
 	IF_EXTRA_COMPAT(            OPTBIT_z ,) /* input is NUL terminated */
+	IF_FEATURE_GREP_PARALLEL(   OPTBIT_j ,) /* -j NUM: worker processes for -r */
 	OPT_l = 1 << OPTBIT_l,
 	OPT_n = 1 << OPTBIT_n,
 	OPT_q = 1 << OPTBIT_q,
@@ -161,6 +195,7 @@ enum {
 	OPT_C = IF_FEATURE_GREP_CONTEXT(    (1 << OPTBIT_C)) + 0,
 	OPT_E = 1 << OPTBIT_E,
 	OPT_z = IF_EXTRA_COMPAT(            (1 << OPTBIT_z)) + 0,
+	OPT_j = IF_FEATURE_GREP_PARALLEL(   (1 << OPTBIT_j)) + 0,
 };
 
 #define PRINT_FILES_WITH_MATCHES    (option_mask32 & OPT_l)
@@ -180,8 +215,13 @@ enum {
 # define IF_EXTRA_COMPAT(x)
 #endif
 
+struct fixed_matcher;
+
 struct globals {
 	int max_matches;
+#if ENABLE_FEATURE_GREP_PARALLEL
+	int max_jobs;
+#endif
 #if !ENABLE_EXTRA_COMPAT
 	int reflags;
 #else
@@ -201,6 +241,9 @@ struct globals {
 	/* globals used internally */
 	llist_t *pattern_head;   /* growable list of patterns to match */
 	const char *cur_file;    /* the current file we are reading */
+#if ENABLE_FEATURE_GREP_FAST_FIXED
+	struct fixed_matcher *fixed; /* -F: all patterns, or NULL */
+#endif
 } FIX_ALIASING;
 #define G (*(struct globals*)bb_common_bufsiz1)
 #define INIT_G() do { \
@@ -208,6 +251,7 @@ struct globals {
 	BUILD_BUG_ON(sizeof(G) > COMMON_BUFSIZE); \
 } while (0)
 #define max_matches       (G.max_matches         )
+#define max_jobs          (G.max_jobs            )
 #if !ENABLE_EXTRA_COMPAT
 # define reflags          (G.reflags             )
 #else
@@ -233,6 +277,7 @@ struct globals {
 #define last_line_printed (G.last_line_printed   )
 #define pattern_head      (G.pattern_head        )
 #define cur_file          (G.cur_file            )
+#define fixed             (G.fixed               )
 
 
 typedef struct grep_list_data_t {
@@ -307,12 +352,425 @@ static ssize_t FAST_FUNC bb_getline(char **line_ptr, size_t *line_alloc_len, FIL
 }
 #endif
 
+#if ENABLE_FEATURE_GREP_FAST_FIXED
+/* -F matcher: all patterns are searched for in one go.
+ * A single pattern uses Boyer-Moore-Horspool,
+ * several patterns use an Aho-Corasick automaton.
+ * The result is the same as calling strstr() for each pattern in turn:
+ * -x and -w are checked for every occurrence, and for -o the pattern
+ * which comes first in pattern_head is reported.
+ */
+struct ac_node {
+	int child;      /* first child (not used for root) */
+	int sibling;    /* next child of our parent */
+	int fail;       /* longest proper suffix which is in the trie */
+	int dict;       /* nearest node on fail chain with out >= 0 (0: none) */
+	int out;        /* index of pattern ending here, or -1 */
+	unsigned char ch;
+};
+
+struct fixed_matcher {
+	unsigned count;
+	grep_list_data_t **pats;
+	unsigned *len;
+	unsigned char fold[256];   /* identity, or tolower() for -i */
+	/* Horspool (count == 1) */
+	unsigned skip[256];
+	/* Aho-Corasick (count > 1) */
+	int root_next[256];        /* transitions from root, 0: none */
+	struct ac_node *node;
+	unsigned nodes;
+};
+
+static int ac_child(struct fixed_matcher *fm, int s, unsigned char c)
+{
+	if (s == 0)
+		return fm->root_next[c];
+	for (s = fm->node[s].child; s; s = fm->node[s].sibling)
+		if (fm->node[s].ch == c)
+			return s;
+	return 0;
+}
+
+static int ac_new_child(struct fixed_matcher *fm, int s, unsigned char c)
+{
+	int n = fm->nodes++;
+	struct ac_node *np;
+
+	fm->node = xrealloc_vector(fm->node, 10, n);
+	np = &fm->node[n];
+	np->ch = c;
+	np->out = -1;
+	if (s == 0) {
+		fm->root_next[c] = n;
+	} else {
+		np->sibling = fm->node[s].child;
+		fm->node[s].child = n;
+	}
+	return n;
+}
+
+static void ac_build(struct fixed_matcher *fm)
+{
+	int *queue;
+	unsigned i, head, tail;
+
+	/* Node 0 is root */
+	fm->nodes = 0;
+	ac_new_child(fm, 0, 0);
+	fm->root_next[0] = 0;
+
+	for (i = 0; i < fm->count; i++) {
+		const unsigned char *p = (unsigned char *)fm->pats[i]->pattern;
+		int s = 0;
+
+		while (*p) {
+			unsigned char c = fm->fold[*p++];
+			int t = ac_child(fm, s, c);
+			if (!t)
+				t = ac_new_child(fm, s, c);
+			s = t;
+		}
+		/* For duplicates, keep the first one */
+		if (fm->node[s].out < 0)
+			fm->node[s].out = i;
+	}
+
+	/* Breadth-first, so that fail links point to finished nodes */
+	queue = xmalloc(fm->nodes * sizeof(queue[0]));
+	head = tail = 0;
+	for (i = 0; i < 256; i++)
+		if (fm->root_next[i])
+			queue[tail++] = fm->root_next[i];
+	while (head < tail) {
+		int u = queue[head++];
+		int v;
+
+		for (v = fm->node[u].child; v; v = fm->node[v].sibling) {
+			unsigned char c = fm->node[v].ch;
+			int f = fm->node[u].fail;
+			int t;
+
+			while ((t = ac_child(fm, f, c)) == 0 && f != 0)
+				f = fm->node[f].fail;
+			fm->node[v].fail = t;
+			fm->node[v].dict = (fm->node[t].out >= 0) ? t : fm->node[t].dict;
+			queue[tail++] = v;
+		}
+	}
+	free(queue);
+}
+
+static struct fixed_matcher *new_fixed_matcher(void)
+{
+	struct fixed_matcher *fm;
+	llist_t *cur;
+	unsigned i;
+
+	for (i = 0, cur = pattern_head; cur; cur = cur->link, i++) {
+		/* "" matches everywhere (and -w needs special care),
+		 * leave that to the generic code */
+		if (!((grep_list_data_t *)cur->data)->pattern[0])
+			return NULL;
+	}
+
+	fm = xzalloc(sizeof(*fm));
+	fm->count = i;
+	fm->pats = xmalloc(i * sizeof(fm->pats[0]));
+	fm->len = xmalloc(i * sizeof(fm->len[0]));
+	for (i = 0, cur = pattern_head; cur; cur = cur->link, i++) {
+		fm->pats[i] = (grep_list_data_t *)cur->data;
+		fm->len[i] = strlen(fm->pats[i]->pattern);
+	}
+	for (i = 0; i < 256; i++)
+		fm->fold[i] = (option_mask32 & OPT_i) ? tolower(i) : i;
+
+	if (fm->count == 1) {
+		const unsigned char *pat = (unsigned char *)fm->pats[0]->pattern;
+		unsigned m = fm->len[0];
+
+		for (i = 0; i < 256; i++)
+			fm->skip[i] = m;
+		for (i = 0; i < m - 1; i++)
+			fm->skip[fm->fold[pat[i]]] = m - 1 - i;
+	} else {
+		ac_build(fm);
+	}
+	return fm;
+}
+
+/* Returns the first occurrence of any pattern in [p, end), or NULL.
+ * -w and -x are not checked */
+static char *fixed_find(struct fixed_matcher *fm, const char *p, const char *end)
+{
+	const unsigned char *fold = fm->fold;
+
+	if (fm->count == 1) {
+		const unsigned char *pat = (unsigned char *)fm->pats[0]->pattern;
+		unsigned m = fm->len[0];
+		unsigned char last = fold[pat[m - 1]];
+		/* q: the text char aligned with pattern's last char */
+		const char *q = p + m - 1;
+
+		while (q < end) {
+			unsigned char c = fold[(unsigned char)*q];
+			if (c == last) {
+				const char *start = q - (m - 1);
+				unsigned j = m - 1;
+				while (j != 0 && fold[(unsigned char)start[j - 1]] == fold[pat[j - 1]])
+					j--;
+				if (j == 0)
+					return (char *)start;
+			}
+			q += fm->skip[c];
+		}
+	} else {
+		struct ac_node *node = fm->node;
+		int s = 0;
+
+		for (; p < end; p++) {
+			unsigned char c = fold[(unsigned char)*p];
+			int t;
+
+			while ((t = ac_child(fm, s, c)) == 0 && s != 0)
+				s = node[s].fail;
+			s = t;
+			t = (node[s].out >= 0) ? s : node[s].dict;
+			if (t)
+				return (char *)p + 1 - fm->len[node[t].out];
+		}
+	}
+	return NULL;
+}
+
+/* Would strstr() loop accept an occurrence at line[start..start+len)? */
+static int fixed_accept(const char *line, unsigned line_len, unsigned start, unsigned len)
+{
+	if (option_mask32 & OPT_x)
+		return start == 0 && len == line_len;
+	if (option_mask32 & OPT_w) {
+		char c = start ? line[start - 1] : ' ';
+		if (isalnum(c) || c == '_')
+			return 0;
+		c = line[start + len];
+		if (c && (isalnum(c) || c == '_'))
+			return 0;
+	}
+	return 1;
+}
+
+/* Returns the matching pattern, or NULL */
+static grep_list_data_t *fixed_match(struct fixed_matcher *fm, const char *line)
+{
+	const unsigned char *fold = fm->fold;
+	unsigned line_len = strlen(line);
+	unsigned i;
+
+	if (fm->count == 1) {
+		const char *p = line;
+		const char *match;
+
+		/* Only an occurrence at 0 can be accepted */
+		if ((option_mask32 & OPT_x) && line_len != fm->len[0])
+			return NULL;
+		while ((match = fixed_find(fm, p, line + line_len)) != NULL) {
+			if (fixed_accept(line, line_len, match - line, fm->len[0]))
+				return fm->pats[0];
+			if (!(option_mask32 & OPT_w) || (option_mask32 & OPT_x))
+				break;
+			p = match + 1;
+		}
+		return NULL;
+	}
+
+	{
+		struct ac_node *node = fm->node;
+		int best = -1;
+		int s = 0;
+
+		for (i = 0; i < line_len; i++) {
+			unsigned char c = fold[(unsigned char)line[i]];
+			int o, t;
+
+			while ((t = ac_child(fm, s, c)) == 0 && s != 0)
+				s = node[s].fail;
+			s = t;
+			for (o = (node[s].out >= 0) ? s : node[s].dict; o; o = node[o].dict) {
+				int idx = node[o].out;
+				unsigned len = fm->len[idx];
+
+				if (!fixed_accept(line, line_len, i + 1 - len, len))
+					continue;
+				/* -o prints the pattern: find the one
+				 * the generic code would have found */
+				if (!(option_mask32 & OPT_o) || idx == 0)
+					return fm->pats[idx];
+				if (best < 0 || idx < best)
+					best = idx;
+			}
+		}
+		return (best >= 0) ? fm->pats[best] : NULL;
+	}
+}
+#endif
+
+#if ENABLE_FEATURE_GREP_BUFFERED
+/* Reads input in large blocks and splits them into lines in place,
+ * lines are valid until the next call. When the -F matcher is usable
+ * (no -v, no context), lines which can't match are not even split:
+ * the block is searched as a whole and we jump to the line of the hit.
+ * As in xmalloc_fgetline(), NUL ends a line too.
+ */
+#define GREP_BUFSIZE (256 * 1024)
+struct line_reader {
+	int fd;
+	smallint eof;
+	smallint skip_to_hit;
+	char *buf;
+	size_t size;
+	char *pos;      /* next line starts here */
+	char *end;      /* end of data, *end is always NUL */
+};
+
+static void reader_init(struct line_reader *r, int fd)
+{
+	r->fd = fd;
+	r->eof = 0;
+	r->skip_to_hit = 0;
+#if ENABLE_FEATURE_GREP_FAST_FIXED
+	r->skip_to_hit = (fixed && !invert_search
+			IF_FEATURE_GREP_CONTEXT(&& !lines_before && !lines_after));
+#endif
+	r->size = GREP_BUFSIZE;
+	r->buf = r->pos = r->end = xmalloc(r->size + 1);
+	*r->end = '\0';
+}
+
+/* Move the incomplete line to the start of buf and read more */
+static void reader_fill(struct line_reader *r)
+{
+	size_t len = r->end - r->pos;
+	ssize_t n;
+
+	memmove(r->buf, r->pos, len);
+	if (len == r->size) {
+		/* Line longer than buf */
+		r->size *= 2;
+		r->buf = xrealloc(r->buf, r->size + 1);
+	}
+	r->pos = r->buf;
+	r->end = r->buf + len;
+	n = safe_read(r->fd, r->end, r->size - len);
+	if (n <= 0) {
+		/* Errors are treated as EOF, as xmalloc_fgetline() does */
+		r->eof = 1;
+		n = 0;
+	}
+	r->end += n;
+	*r->end = '\0';
+}
+
+/* Last end of line in [p, end), or NULL */
+static char *last_eol(char *p, char *end)
+{
+	char *nl = memrchr(p, '\n', end - p);
+	char *z;
+
+	if (nl)
+		p = nl + 1;
+	z = memrchr(p, '\0', end - p);
+	return z ? z : nl;
+}
+
+static int count_char(const char *p, const char *end, char c)
+{
+	int n = 0;
+
+	while ((p = memchr(p, c, end - p)) != NULL) {
+		n++;
+		p++;
+	}
+	return n;
+}
+
+/* Advance pos to the start of the line in which the first hit is,
+ * counting skipped lines. Returns 0 if there are no more hits.
+ */
+static int reader_skip(struct line_reader *r, int *linenum)
+{
+	for (;;) {
+		char *hit = fixed_find(fixed, r->pos, r->end);
+		char *nl;
+
+		if (hit) {
+			nl = last_eol(r->pos, hit);
+		} else {
+			if (r->eof)
+				return 0;
+			/* Keep the last (incomplete) line, the hit may be in it */
+			nl = last_eol(r->pos, r->end);
+		}
+		if (nl) {
+			if (PRINT_LINE_NUM) {
+				*linenum += count_char(r->pos, nl + 1, '\n')
+					+ count_char(r->pos, nl + 1, '\0');
+			}
+			r->pos = nl + 1;
+		}
+		if (hit)
+			return 1;
+		reader_fill(r);
+	}
+}
+
+static char *reader_line(struct line_reader *r, int *linenum)
+{
+	char *line, *nl;
+
+	if (r->skip_to_hit && !reader_skip(r, linenum))
+		return NULL;
+	for (;;) {
+		/* Stops at a NUL in data, or at the one at end */
+		nl = strchrnul(r->pos, '\n');
+		if (nl != r->end)
+			break;
+		if (r->eof) {
+			if (r->pos == r->end)
+				return NULL;
+			/* Last line has no newline */
+			break;
+		}
+		reader_fill(r);
+	}
+	*nl = '\0';
+	line = r->pos;
+	r->pos = nl + (nl != r->end);
+	return line;
+}
+#endif
+
+static void compile_pattern(grep_list_data_t *gl)
+{
+	gl->flg_mem_allocated_compiled |= COMPILED;
+#if !ENABLE_EXTRA_COMPAT
+	xregcomp(&gl->compiled_regex, gl->pattern, reflags);
+#else
+	memset(&gl->compiled_regex, 0, sizeof(gl->compiled_regex));
+	gl->compiled_regex.translate = case_fold; /* for -i */
+	if (re_compile_pattern(gl->pattern, strlen(gl->pattern), &gl->compiled_regex))
+		bb_error_msg_and_die("bad regex '%s'", gl->pattern);
+#endif
+}
+
 static int grep_file(FILE *file)
 {
 	smalluint found;
 	int linenum = 0;
 	int nmatches = 0;
-#if !ENABLE_EXTRA_COMPAT
+#if ENABLE_FEATURE_GREP_BUFFERED
+	struct line_reader rd;
+	char *line;
+#elif !ENABLE_EXTRA_COMPAT
 	char *line;
 #else
 	char *line = NULL;
@@ -329,8 +787,13 @@ static int grep_file(FILE *file)
 	enum { print_n_lines_after = 0 };
 #endif
 
+#if ENABLE_FEATURE_GREP_BUFFERED
+	reader_init(&rd, fileno(file));
+#endif
 	while (
-#if !ENABLE_EXTRA_COMPAT
+#if ENABLE_FEATURE_GREP_BUFFERED
+		(line = reader_line(&rd, &linenum)) != NULL
+#elif !ENABLE_EXTRA_COMPAT
 		(line = xmalloc_fgetline(file)) != NULL
 #else
 		(line_len = bb_getline(&line, &line_alloc_len, file)) >= 0
@@ -341,6 +804,13 @@ static int grep_file(FILE *file)
 
 		linenum++;
 		found = 0;
+#if ENABLE_FEATURE_GREP_FAST_FIXED
+		if (fixed) {
+			gl = fixed_match(fixed, line);
+			found = (gl != NULL);
+			pattern_ptr = NULL;
+		}
+#endif
 		while (pattern_ptr) {
 			gl = (grep_list_data_t *)pattern_ptr->data;
 			if (FGREP_FLAG) {
@@ -359,7 +829,7 @@ static int grep_file(FILE *file)
 							goto opt_f_not_found;
 					} else
 					if (option_mask32 & OPT_w) {
-						char c = (match != str) ? match[-1] : ' ';
+						char c = (match != line) ? match[-1] : ' ';
 						if (!isalnum(c) && c != '_') {
 							c = match[strlen(gl->pattern)];
 							if (!c || (!isalnum(c) && c != '_'))
@@ -380,17 +850,8 @@ static int grep_file(FILE *file)
 #endif
 				char *match_at;
 
-				if (!(gl->flg_mem_allocated_compiled & COMPILED)) {
-					gl->flg_mem_allocated_compiled |= COMPILED;
-#if !ENABLE_EXTRA_COMPAT
-					xregcomp(&gl->compiled_regex, gl->pattern, reflags);
-#else
-					memset(&gl->compiled_regex, 0, sizeof(gl->compiled_regex));
-					gl->compiled_regex.translate = case_fold; /* for -i */
-					if (re_compile_pattern(gl->pattern, strlen(gl->pattern), &gl->compiled_regex))
-						bb_error_msg_and_die("bad regex '%s'", gl->pattern);
-#endif
-				}
+				if (!(gl->flg_mem_allocated_compiled & COMPILED))
+					compile_pattern(gl);
 #if !ENABLE_EXTRA_COMPAT
 				gl->matched_range.rm_so = 0;
 				gl->matched_range.rm_eo = 0;
@@ -464,7 +925,11 @@ static int grep_file(FILE *file)
 
 			/* quiet/print (non)matching file names only? */
 			if (option_mask32 & (OPT_q|OPT_l|OPT_L)) {
+#if ENABLE_FEATURE_GREP_BUFFERED
+				free(rd.buf);
+#else
 				free(line); /* we don't need line anymore */
+#endif
 				if (BE_QUIET) {
 					/* manpage says about -q:
 					 * "exit immediately with zero status
@@ -566,7 +1031,12 @@ static int grep_file(FILE *file)
 			} else if (lines_before) {
 				/* Add the line to the circular 'before' buffer */
 				free(before_buf[curpos]);
+#if ENABLE_FEATURE_GREP_BUFFERED
+				/* line is in the reader's buffer */
+				before_buf[curpos] = xstrdup(line);
+#else
 				before_buf[curpos] = line;
+#endif
 				IF_EXTRA_COMPAT(before_buf_size[curpos] = line_len;)
 				curpos = (curpos + 1) % lines_before;
 				/* avoid free(line) - we took the line */
@@ -575,7 +1045,7 @@ static int grep_file(FILE *file)
 		}
 
 #endif /* ENABLE_FEATURE_GREP_CONTEXT */
-#if !ENABLE_EXTRA_COMPAT
+#if !ENABLE_EXTRA_COMPAT && !ENABLE_FEATURE_GREP_BUFFERED
 		free(line);
 #endif
 		/* Did we print all context after last requested match? */
@@ -586,6 +1056,9 @@ static int grep_file(FILE *file)
 			break;
 		}
 	} /* while (read line) */
+#if ENABLE_FEATURE_GREP_BUFFERED
+	free(rd.buf);
+#endif
 
 	/* special-case file post-processing for options where we don't print line
 	 * matches, just filenames and possibly match counts */
@@ -663,13 +1136,176 @@ static int FAST_FUNC file_action_grep(const char *filename,
 	return 1;
 }
 
+#if ENABLE_FEATURE_GREP_PARALLEL
+/* grep -r -j N: the tree is walked first, then files are handed out
+ * round-robin to N worker processes. Each worker writes its output to
+ * its own (unlinked) temp file, and after every file it tells us where
+ * that file's output is. We copy the pieces to stdout in file order,
+ * so output is exactly what we would print without -j.
+ * Workers print no errors: they send errno, we print it in order.
+ */
+struct grep_result {
+	off_t start, end;
+	int matched;
+	int open_errno;
+};
+
+struct name_list {
+	char **names;
+	unsigned count;
+};
+
+static int FAST_FUNC file_action_collect(const char *filename,
+			struct stat *statbuf UNUSED_PARAM,
+			void* list,
+			int depth UNUSED_PARAM)
+{
+	struct name_list *l = list;
+
+	l->names = xrealloc_vector(l->names, 6, l->count);
+	l->names[l->count++] = xstrdup(filename);
+	return 1;
+}
+
+static int grep_files_parallel(char **names, unsigned count, unsigned nworkers)
+{
+	const char *tmp_dir = getenv("TMPDIR");
+	int *ctl, *out;
+	pid_t *pids;
+	char *buf;
+	unsigned i;
+	int matched = 0;
+
+	if (!tmp_dir || !tmp_dir[0])
+		tmp_dir = "/tmp";
+	ctl = xmalloc(nworkers * sizeof(ctl[0]));
+	out = xmalloc(nworkers * sizeof(out[0]));
+	pids = xmalloc(nworkers * sizeof(pids[0]));
+	/* A bad regex is reported once, by us, not by every worker */
+	if (!FGREP_FLAG) {
+		llist_t *p;
+
+		for (p = pattern_head; p; p = p->link) {
+			grep_list_data_t *gl = (grep_list_data_t *)p->data;
+			if (!(gl->flg_mem_allocated_compiled & COMPILED))
+				compile_pattern(gl);
+		}
+	}
+	/* Don't let children duplicate what we have buffered */
+	fflush_all();
+	for (i = 0; i < nworkers; i++) {
+		char *name = concat_path_file(tmp_dir, "grepXXXXXX");
+		struct fd_pair fds;
+
+		out[i] = xmkstemp(name);
+		unlink(name);
+		free(name);
+		xpiped_pair(fds);
+		pids[i] = xfork();
+		if (pids[i] == 0) {
+			/* child */
+			unsigned n;
+
+			close(fds.rd);
+			xdup2(out[i], STDOUT_FILENO);
+			for (n = i; n < count; n += nworkers) {
+				struct grep_result res;
+				FILE *file;
+
+				res.matched = 0;
+				res.open_errno = 0;
+				res.start = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+				file = fopen_for_read(names[n]);
+				if (file == NULL) {
+					res.open_errno = errno;
+				} else {
+					cur_file = names[n];
+					res.matched = grep_file(file);
+					fclose(file);
+				}
+				fflush_all();
+				res.end = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+				xwrite(fds.wr, &res, sizeof(res));
+			}
+			_exit(EXIT_SUCCESS);
+		}
+		close(fds.wr);
+		ctl[i] = fds.rd;
+	}
+
+	buf = xmalloc(COMMON_BUFSIZE);
+	for (i = 0; i < count; i++) {
+		struct grep_result res;
+		int j = i % nworkers;
+
+		if (full_read(ctl[j], &res, sizeof(res)) != sizeof(res))
+			bb_error_msg_and_die("worker died");
+		if (res.open_errno) {
+			if (!SUPPRESS_ERR_MSGS) {
+				errno = res.open_errno;
+				bb_simple_perror_msg(names[i]);
+			}
+			open_errors = 1;
+		}
+		/* The file offset is shared with the worker, so pread */
+		while (res.start < res.end) {
+			size_t sz = MIN(res.end - res.start, COMMON_BUFSIZE);
+			ssize_t rd = pread(out[j], buf, sz, res.start);
+			if (rd <= 0)
+				bb_perror_msg_and_die("read error");
+			xwrite(STDOUT_FILENO, buf, rd);
+			res.start += rd;
+		}
+		matched += res.matched;
+	}
+	for (i = 0; i < nworkers; i++) {
+		int status;
+
+		close(ctl[i]);
+		close(out[i]);
+		/* A worker which failed after its last result
+		 * (e.g. write error) makes it an error for us too */
+		if (safe_waitpid(pids[i], &status, 0) < 0 || status != 0)
+			open_errors = 1;
+	}
+	if (ENABLE_FEATURE_CLEAN_UP) {
+		free(buf);
+		free(ctl);
+		free(out);
+		free(pids);
+	}
+	return matched;
+}
+#endif
+
 static int grep_dir(const char *dir)
 {
 	int matched = 0;
+#if ENABLE_FEATURE_GREP_PARALLEL
+	if (max_jobs > 1) {
+		struct name_list l = { NULL, 0 };
+		unsigned i;
+
+		/* Same flags as below */
+		recursive_action(dir,
+			ACTION_RECURSE | ACTION_FOLLOWLINKS_L0 | ACTION_DEPTHFIRST
+			| ACTION_LAZY_STAT,
+			file_action_collect, NULL, &l, 0);
+		if (l.count > 1)
+			matched = grep_files_parallel(l.names, l.count, MIN(max_jobs, l.count));
+		else if (l.count == 1)
+			file_action_grep(l.names[0], NULL, &matched, 0);
+		for (i = 0; i < l.count; i++)
+			free(l.names[i]);
+		free(l.names);
+		return matched;
+	}
+#endif
 	recursive_action(dir,
 		/* recurse=yes */ ACTION_RECURSE |
 		/* followLinks=command line only */ ACTION_FOLLOWLINKS_L0 |
-		/* depthFirst=yes */ ACTION_DEPTHFIRST,
+		/* depthFirst=yes */ ACTION_DEPTHFIRST |
+		/* statbuf is not used */ ACTION_LAZY_STAT,
 		/* fileAction= */ file_action_grep,
 		/* dirAction= */ NULL,
 		/* userData= */ &matched,
@@ -699,7 +1335,8 @@ int grep_main(int argc UNUSED_PARAM, char **argv)
 	opts = getopt32(argv,
 		OPTSTR_GREP,
 		&pattern_head, &fopt, &max_matches,
-		&lines_after, &lines_before, &Copt);
+		&lines_after, &lines_before, &Copt
+		IF_FEATURE_GREP_PARALLEL(, &max_jobs));
 
 	if (opts & OPT_C) {
 		/* -C unsets prev -A and -B, but following -A or -B
@@ -726,9 +1363,20 @@ int grep_main(int argc UNUSED_PARAM, char **argv)
 	/* -H unsets -h; -c,-q or -l unset -n; -e,-f are lists; -m N */
 	opt_complementary = "H-h:c-n:q-n:l-n:";
 	getopt32(argv, OPTSTR_GREP,
-		&pattern_head, &fopt, &max_matches);
+		&pattern_head, &fopt, &max_matches
+		IF_FEATURE_GREP_PARALLEL(, &max_jobs));
 #endif
 	invert_search = ((option_mask32 & OPT_v) != 0); /* 0 | 1 */
+#if ENABLE_FEATURE_GREP_PARALLEL
+	/* -q exits on first match, and "--" separators between
+	 * context lines depend on what was printed for previous files */
+	if (BE_QUIET)
+		max_jobs = 0;
+# if ENABLE_FEATURE_GREP_CONTEXT
+	if (lines_before || lines_after)
+		max_jobs = 0;
+# endif
+#endif
 
 	{	/* convert char **argv to grep_list_data_t */
 		llist_t *cur;
@@ -787,6 +1435,10 @@ int grep_main(int argc UNUSED_PARAM, char **argv)
 		pattern = new_grep_list_data(*argv++, 0);
 		llist_add_to(&pattern_head, pattern);
 	}
+#if ENABLE_FEATURE_GREP_FAST_FIXED
+	if (FGREP_FLAG)
+		fixed = new_fixed_matcher();
+#endif
 
 	/* argv[0..(argc-1)] should be names of file to grep through. If
 	 * there is more than one file to grep, we will print the filenames. */
@@ -832,6 +1484,14 @@ int grep_main(int argc UNUSED_PARAM, char **argv)
 
 	/* destroy all the elments in the pattern list */
 	if (ENABLE_FEATURE_CLEAN_UP) {
+#if ENABLE_FEATURE_GREP_FAST_FIXED
+		if (fixed) {
+			free(fixed->pats);
+			free(fixed->len);
+			free(fixed->node);
+			free(fixed);
+		}
+#endif
 		while (pattern_head) {
 			llist_t *pattern_head_ptr = pattern_head;
 			grep_list_data_t *gl = (grep_list_data_t *)pattern_head_ptr->data;
@@ -60,6 +60,14 @@
 //config:	depends on XARGS
 //config:	help
 //config:	  Support -I STR and -i[STR] options.
+//config:
+//config:config FEATURE_XARGS_SUPPORT_PARALLEL
+//config:	bool "Enable -P N: run up to N commands in parallel"
+//config:	default y
+//config:	depends on XARGS && PLATFORM_POSIX
+//config:	help
+//config:	  Support -P N: start the next command without waiting
+//config:	  for the previous one, as long as fewer than N are running.
 
 //applet:IF_XARGS(APPLET_NOEXEC(xargs, xargs, BB_DIR_USR_BIN, BB_SUID_DROP, xargs))
 
@@ -103,6 +111,10 @@ struct globals {
 #endif
 	const char *eof_str;
 	int idx;
+#if ENABLE_FEATURE_XARGS_SUPPORT_PARALLEL
+	int running_procs;
+	int max_procs;
+#endif
 } FIX_ALIASING;
 #define G (*(struct globals*)bb_common_bufsiz1)
 #define INIT_G() do { \
@@ -110,25 +122,25 @@ struct globals {
 	G.eof_str = NULL; /* need to clear by hand because we are NOEXEC applet */ \
 	IF_FEATURE_XARGS_SUPPORT_REPL_STR(G.repl_str = "{}";) \
 	IF_FEATURE_XARGS_SUPPORT_REPL_STR(G.eol_ch = '\n';) \
+	IF_FEATURE_XARGS_SUPPORT_PARALLEL(G.running_procs = 0;) \
+	IF_FEATURE_XARGS_SUPPORT_PARALLEL(G.max_procs = 1;) \
 } while (0)
 
 
-static int xargs_exec(void)
+/* Turn wait4pid()-style status of PROG into our exit code */
+static int exec_status(int status, const char *prog)
 {
-	int status;
-
-	status = spawn_and_wait(G.args);
 	if (status < 0) {
-		bb_simple_perror_msg(G.args[0]);
+		bb_simple_perror_msg(prog);
 		return errno == ENOENT ? 127 : 126;
 	}
 	if (status == 255) {
-		bb_error_msg("%s: exited with status 255; aborting", G.args[0]);
+		bb_error_msg("%s: exited with status 255; aborting", prog);
 		return 124;
 	}
 	if (status >= 0x180) {
 		bb_error_msg("'%s' terminated by signal %d",
-			G.args[0], status - 0x180);
+			prog, status - 0x180);
 		return 125;
 	}
 	if (status)
@@ -136,6 +148,63 @@ static int xargs_exec(void)
 	return 0;
 }
 
+#if ENABLE_FEATURE_XARGS_SUPPORT_PARALLEL
+/* Reap one child (wait for it if BLOCK). Returns -1 if there was none,
+ * else exit code as above, worst of several is the biggest one */
+static int reap_child(int block, const char *prog)
+{
+	int wstat;
+	pid_t pid;
+
+	pid = block ? safe_waitpid(-1, &wstat, 0) : wait_any_nohang(&wstat);
+	if (pid <= 0)
+		return -1;
+	/* We may have children we didn't start:
+	 * sh -c 'sleep 1 & exec xargs ...'
+	 * Don't make running_procs go negative */
+	if (G.running_procs != 0)
+		G.running_procs--;
+	return exec_status(WIFSIGNALED(wstat) ? WTERMSIG(wstat) + 0x180
+			: WEXITSTATUS(wstat), prog);
+}
+
+/* Wait for all children, return the worst exit code */
+static int reap_all(const char *prog)
+{
+	int rc = 0;
+	while (G.running_procs != 0) {
+		int st = reap_child(1, prog);
+		if (st < 0)
+			break;
+		rc = MAX(rc, st);
+	}
+	return rc;
+}
+#endif
+
+static int xargs_exec(void)
+{
+#if ENABLE_FEATURE_XARGS_SUPPORT_PARALLEL
+	if (G.max_procs != 1) {
+		int rc = 0;
+		int st;
+		pid_t pid;
+
+		/* Collect those which are done, wait if no slot is free */
+		while ((st = reap_child(G.running_procs >= G.max_procs, G.args[0])) >= 0)
+			rc = MAX(rc, st);
+		pid = spawn(G.args);
+		if (pid < 0) {
+			st = exec_status(-1, G.args[0]);
+			return MAX(rc, st);
+		}
+		G.running_procs++;
+		return rc;
+	}
+#endif
+	return exec_status(spawn_and_wait(G.args), G.args[0]);
+}
+
 /* In POSIX/C locale isspace is only these chars: "\t\n\v\f\r" and space.
  * "\t\n\v\f\r" happen to have ASCII codes 9,10,11,12,13.
  */
@@ -452,6 +521,9 @@ static int xargs_ask_confirmation(void)
 //usage:	IF_FEATURE_XARGS_SUPPORT_TERMOPT(
 //usage:     "\n	-x	Exit if size is exceeded"
 //usage:	)
+//usage:	IF_FEATURE_XARGS_SUPPORT_PARALLEL(
+//usage:     "\n	-P N	Run up to N PROGs in parallel (0: no limit)"
+//usage:	)
 //usage:#define xargs_example_usage
 //usage:       "$ ls | xargs gzip\n"
 //usage:       "$ find . -name '*.c' -print | xargs rm\n"
@@ -469,6 +541,7 @@ enum {
 	IF_FEATURE_XARGS_SUPPORT_ZERO_TERM(   OPTBIT_ZEROTERM   ,)
 	IF_FEATURE_XARGS_SUPPORT_REPL_STR(    OPTBIT_REPLSTR    ,)
 	IF_FEATURE_XARGS_SUPPORT_REPL_STR(    OPTBIT_REPLSTR1   ,)
+	IF_FEATURE_XARGS_SUPPORT_PARALLEL(    OPTBIT_PARALLEL   ,)
 
 	OPT_VERBOSE     = 1 << OPTBIT_VERBOSE    ,
 	OPT_NO_EMPTY    = 1 << OPTBIT_NO_EMPTY   ,
@@ -481,12 +554,14 @@ enum {
 	OPT_ZEROTERM    = IF_FEATURE_XARGS_SUPPORT_ZERO_TERM(   (1 << OPTBIT_ZEROTERM   )) + 0,
 	OPT_REPLSTR     = IF_FEATURE_XARGS_SUPPORT_REPL_STR(    (1 << OPTBIT_REPLSTR    )) + 0,
 	OPT_REPLSTR1    = IF_FEATURE_XARGS_SUPPORT_REPL_STR(    (1 << OPTBIT_REPLSTR1   )) + 0,
+	OPT_PARALLEL    = IF_FEATURE_XARGS_SUPPORT_PARALLEL(    (1 << OPTBIT_PARALLEL   )) + 0,
 };
 #define OPTION_STR "+trn:s:e::E:" \
 	IF_FEATURE_XARGS_SUPPORT_CONFIRMATION("p") \
 	IF_FEATURE_XARGS_SUPPORT_TERMOPT(     "x") \
 	IF_FEATURE_XARGS_SUPPORT_ZERO_TERM(   "0") \
-	IF_FEATURE_XARGS_SUPPORT_REPL_STR(    "I:i::")
+	IF_FEATURE_XARGS_SUPPORT_REPL_STR(    "I:i::") \
+	IF_FEATURE_XARGS_SUPPORT_PARALLEL(    "P:+")
 
 int xargs_main(int argc, char **argv) MAIN_EXTERNALLY_VISIBLE;
 int xargs_main(int argc, char **argv)
@@ -517,7 +592,12 @@ int xargs_main(int argc, char **argv)
 	opt = getopt32(argv, OPTION_STR,
 		&max_args, &max_chars, &G.eof_str, &G.eof_str
 		IF_FEATURE_XARGS_SUPPORT_REPL_STR(, &G.repl_str, &G.repl_str)
+		IF_FEATURE_XARGS_SUPPORT_PARALLEL(, &G.max_procs)
 	);
+#if ENABLE_FEATURE_XARGS_SUPPORT_PARALLEL
+	if (G.max_procs <= 0) /* -P0: no limit */
+		G.max_procs = INT_MAX;
+#endif
 
 	/* -E ""? You may wonder why not just omit -E?
 	 * This is used for portability:
@@ -641,7 +721,10 @@ int xargs_main(int argc, char **argv)
 		}
 
 		if (!(opt & OPT_INTERACTIVE) || xargs_ask_confirmation()) {
-			child_error = xargs_exec();
+			/* 123 ("some PROG failed") sticks, others stop us */
+			i = xargs_exec();
+			if (child_error < i)
+				child_error = i;
 		}
 
 		if (child_error > 0 && child_error != 123) {
@@ -650,6 +733,11 @@ int xargs_main(int argc, char **argv)
 
 		overlapping_strcpy(buf, rem);
 	} /* while */
+#if ENABLE_FEATURE_XARGS_SUPPORT_PARALLEL
+	i = reap_all(argv[0]);
+	if (child_error < i)
+		child_error = i;
+#endif
 
 	if (ENABLE_FEATURE_CLEAN_UP) {
 		free(G.args);
@@ -38,12 +38,24 @@ enum {
 #endif
 };
 
+/* A data extent of a sparse file */
+typedef struct sparse_extent_t {
+	off_t offset;
+	off_t numbytes;
+} sparse_extent_t;
+
 typedef struct file_header_t {
 	char *name;
 	char *link_target;
 #if ENABLE_FEATURE_TAR_UNAME_GNAME
 	char *tar__uname;
 	char *tar__gname;
+#endif
+#if ENABLE_FEATURE_TAR_SPARSE
+	/* GNU sparse member: size is the sum of numbytes of extents */
+	sparse_extent_t *tar__sparse;
+	unsigned tar__sparse_cnt;
+	off_t tar__realsize;
 #endif
 	off_t size;
 	uid_t uid;
@@ -105,6 +117,9 @@ typedef struct archive_handle_t {
 # if ENABLE_FEATURE_TAR_SELINUX
 	char* tar__sctx[2];
 # endif
+# if ENABLE_FEATURE_TAR_JOBS
+	struct tar_jobs_t *tar__jobs;
+# endif
 #endif
 #if ENABLE_CPIO || ENABLE_RPM2CPIO || ENABLE_RPM
 	uoff_t cpio__blocks;
@@ -172,6 +187,34 @@ struct BUG_tar_header {
 	char c[sizeof(tar_header_t) == TAR_BLOCK_SIZE ? 1 : -1];
 };
 
+/* GNU sparse member (typeflag 'S', "old GNU" format):
+ * the map of data extents is where ustar has prefix[] */
+typedef struct tar_sparse_entry_t {
+	char offset[12];
+	char numbytes[12];
+} tar_sparse_entry_t;
+typedef struct tar_sparse_header_t { /* byte offset */
+	char atime[12];           /* 345-356 */
+	char ctime[12];           /* 357-368 */
+	char offset[12];          /* 369-380 */
+	char longnames[4];        /* 381-384 */
+	char unused;              /* 385-385 */
+	tar_sparse_entry_t sp[4]; /* 386-481 */
+	char isextended;          /* 482-482 */
+	char realsize[12];        /* 483-494 */
+	char pad[17];             /* 495-511 */
+} tar_sparse_header_t;
+/* If isextended, the header is followed by blocks with more entries */
+typedef struct tar_sparse_ext_t {
+	tar_sparse_entry_t sp[21]; /*  0-503 */
+	char isextended;           /* 504-504 */
+	char pad[7];               /* 505-511 */
+} tar_sparse_ext_t;
+struct BUG_tar_sparse_header {
+	char c[offsetof(tar_header_t, prefix) + sizeof(tar_sparse_header_t) == TAR_BLOCK_SIZE
+		&& sizeof(tar_sparse_ext_t) == TAR_BLOCK_SIZE ? 1 : -1];
+};
+
 
 extern const char cpio_TRAILER[];
 
@@ -189,6 +232,16 @@ void data_skip(archive_handle_t *archive_handle) FAST_FUNC;
 void data_extract_all(archive_handle_t *archive_handle) FAST_FUNC;
 void data_extract_to_stdout(archive_handle_t *archive_handle) FAST_FUNC;
 void data_extract_to_command(archive_handle_t *archive_handle) FAST_FUNC;
+/* Flags for data_extract_sparse() */
+#define SPARSE_NEW_FILE            (1 << 0) /* dst_fd can have holes */
+#define SPARSE_IGNORE_WRITE_ERRORS (1 << 1)
+void data_extract_sparse(archive_handle_t *archive_handle, int dst_fd, unsigned flags) FAST_FUNC;
+/* tar -x --jobs N */
+void tar_jobs_start(archive_handle_t *archive_handle, unsigned n) FAST_FUNC;
+void tar_jobs_sync_for(archive_handle_t *archive_handle, const char *name) FAST_FUNC;
+int tar_jobs_extract_file(archive_handle_t *archive_handle, const char *dst_name, uid_t uid, gid_t gid) FAST_FUNC;
+void tar_jobs_add_dir(archive_handle_t *archive_handle, const char *dst_name, uid_t uid, gid_t gid) FAST_FUNC;
+int tar_jobs_finish(archive_handle_t *archive_handle) FAST_FUNC;
 
 void header_skip(const file_header_t *file_header) FAST_FUNC;
 void header_list(const file_header_t *file_header) FAST_FUNC;
@@ -248,6 +301,9 @@ int check_signature16(transformer_state_t *xstate, unsigned magic16) FAST_FUNC;
 IF_DESKTOP(long long) int inflate_unzip(transformer_state_t *xstate) FAST_FUNC;
 IF_DESKTOP(long long) int unpack_Z_stream(transformer_state_t *xstate) FAST_FUNC;
 IF_DESKTOP(long long) int unpack_gz_stream(transformer_state_t *xstate) FAST_FUNC;
+IF_DESKTOP(long long) int unpack_gz_stream_parallel(transformer_state_t *xstate, unsigned jobs) FAST_FUNC;
+int gz_index_build(transformer_state_t *xstate, int idx_fd) FAST_FUNC;
+IF_DESKTOP(long long) int unpack_gz_range(transformer_state_t *xstate, int idx_fd, off_t offset, off_t length) FAST_FUNC;
 IF_DESKTOP(long long) int unpack_bz2_stream(transformer_state_t *xstate) FAST_FUNC;
 IF_DESKTOP(long long) int unpack_lzma_stream(transformer_state_t *xstate) FAST_FUNC;
 IF_DESKTOP(long long) int unpack_xz_stream(transformer_state_t *xstate) FAST_FUNC;
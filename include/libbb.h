@@ -396,6 +396,10 @@ enum {	/* cp.c, mv.c, install.c depend on these values. CAREFUL when changing th
 	 * Hole. cp may have some bits set here,
 	 * they should not affect remove_file()/copy_file()
 	 */
+	FILEUTILS_SPARSE_ALWAYS   = 1 << 26, /* --sparse=always */
+	FILEUTILS_SPARSE_NEVER    = 1 << 27, /* --sparse=never */
+	FILEUTILS_REFLINK         = 1 << 28, /* --reflink[=auto] */
+	FILEUTILS_REFLINK_ALWAYS  = 1 << 29, /* --reflink=always */
 #if ENABLE_SELINUX
 	FILEUTILS_SET_SECURITY_CONTEXT = 1 << 30,
 #endif
@@ -417,12 +421,52 @@ enum {
 	/*ACTION_REVERSE      = (1 << 4), - unused */
 	ACTION_QUIET          = (1 << 5),
 	ACTION_DANGLING_OK    = (1 << 6),
+	/* Don't stat entries whose type readdir already knows: their statbuf
+	 * has only S_IFMT bits of st_mode set and st_nlink == 0 */
+	ACTION_LAZY_STAT      = (1 << 7),
 };
 typedef uint8_t recurse_flags_t;
 extern int recursive_action(const char *fileName, unsigned flags,
 	int FAST_FUNC (*fileAction)(const char *fileName, struct stat* statbuf, void* userData, int depth),
 	int FAST_FUNC (*dirAction)(const char *fileName, struct stat* statbuf, void* userData, int depth),
 	void* userData, unsigned depth) FAST_FUNC;
+/* Helpers for walking directory trees. Entries are stat'ed and opened
+ * relative to their directory's fd (dir_fd, name), their full path
+ * is kept in one reusable buffer (w->path). Without *at() functions
+ * w->path is used for everything. Start with dir_fd = AT_FDCWD
+ * and name = w->path, for entries of a DIR use dir_walk_fd(dir).
+ */
+typedef struct dir_walk {
+	char *path;
+	unsigned len;
+	unsigned size;
+} dir_walk_t;
+void dir_walk_init(dir_walk_t *w, const char *path) FAST_FUNC;
+/* Append "/name" to w->path. Returns length to pass to dir_walk_pop */
+unsigned dir_walk_push(dir_walk_t *w, const char *name) FAST_FUNC;
+#define dir_walk_pop(w, l) ((w)->path[(w)->len = (l)] = '\0')
+int dir_walk_stat(dir_walk_t *w, int dir_fd, const char *name, struct stat *st, int follow) FAST_FUNC;
+DIR *dir_walk_opendir(dir_walk_t *w, int dir_fd, const char *name, int follow) FAST_FUNC;
+#ifdef DT_UNKNOWN
+# define dirent_type(de) ((de)->d_type)
+#else
+/* No d_type (e.g. mingw): type is never known, ACTION_LAZY_STAT is a no-op */
+# define DT_UNKNOWN 0
+# define DT_DIR     4
+# define DT_LNK     10
+# define dirent_type(de) DT_UNKNOWN
+#endif
+#ifndef DTTOIF
+# define DTTOIF(t) ((t) << 12)
+#endif
+#ifdef HAVE_OPENAT
+# define dir_walk_fd(dir) dirfd(dir)
+#else
+# define dir_walk_fd(dir) (-1)
+# ifndef AT_FDCWD
+#  define AT_FDCWD (-100)
+# endif
+#endif
 extern int device_open(const char *device, int mode) FAST_FUNC;
 enum { GETPTY_BUFSIZE = 16 }; /* more than enough for "/dev/ttyXXX" */
 extern int xgetpty(char *line) FAST_FUNC;
@@ -433,6 +477,10 @@ extern char *find_block_device(const char *path) FAST_FUNC;
 extern off_t bb_copyfd_eof(int fd1, int fd2) FAST_FUNC;
 extern off_t bb_copyfd_size(int fd1, int fd2, off_t size) FAST_FUNC;
 extern void bb_copyfd_exact_size(int fd1, int fd2, off_t size) FAST_FUNC;
+/* Copy size bytes of regular file fd1, leaving holes of fd1 as holes */
+extern off_t bb_copyfd_holes(int fd1, int fd2, off_t size) FAST_FUNC;
+/* Copy size bytes (0: till EOF), making holes of all-zero blocks in fd2 */
+extern off_t bb_copyfd_sparse(int fd1, int fd2, off_t size) FAST_FUNC;
 /* "short" copy can be detected by return value < size */
 /* this helper yells "short read!" if param is not -1 */
 extern void complain_copyfd_and_die(off_t sz) NORETURN FAST_FUNC;
@@ -846,6 +894,12 @@ extern ssize_t safe_write(int fd, const void *buf, size_t count) FAST_FUNC;
 // NB: will return short write on error, not -1,
 // if some data was written before error occurred
 extern ssize_t full_write(int fd, const void *buf, size_t count) FAST_FUNC;
+/* Same, but seeks over all-zero blocks if fd is seekable.
+ * full_write_sparse_end() then must set the size of the file,
+ * in case it ends in a hole */
+extern int is_zero_block(const void *buf, size_t count) FAST_FUNC;
+extern ssize_t full_write_sparse(int fd, const void *buf, size_t count) FAST_FUNC;
+extern int full_write_sparse_end(int fd) FAST_FUNC;
 extern void xwrite(int fd, const void *buf, size_t count) FAST_FUNC;
 extern void xwrite_str(int fd, const char *str) FAST_FUNC;
 extern ssize_t full_write1_str(const char *str) FAST_FUNC;
@@ -1477,6 +1531,12 @@ int bb_xioctl(int fd, unsigned request, void *argp) FAST_FUNC;
 #define xioctl(fd,request,argp)        bb_xioctl(fd,request,argp)
 #endif
 
+/* Growable dev/ino -> pointer map, NULL is an empty map */
+typedef struct ino_dev_table ino_dev_table_t;
+void *ino_dev_table_find(ino_dev_table_t *t, const struct stat *statbuf) FAST_FUNC;
+void **ino_dev_table_add(ino_dev_table_t **tp, const struct stat *statbuf) FAST_FUNC;
+void ino_dev_table_free(ino_dev_table_t *t, void FAST_FUNC (*free_data)(void *data)) FAST_FUNC;
+/* One such map of names, used by du and cp */
 char *is_in_ino_dev_hashtable(const struct stat *statbuf) FAST_FUNC;
 void add_to_ino_dev_hashtable(const struct stat *statbuf, const char *name) FAST_FUNC;
 void reset_ino_dev_hashtable(void) FAST_FUNC;
@@ -1794,6 +1854,8 @@ void sha3_hash(sha3_ctx_t *ctx, const void *buffer, size_t len) FAST_FUNC;
 void sha3_end(sha3_ctx_t *ctx, void *resbuf) FAST_FUNC;
 
 extern uint32_t *global_crc32_table;
+/* crc32_block_endianN() must be given a table allocated
+ * by crc32_filltable(NULL, N): it may be larger than 256 entries */
 uint32_t *crc32_filltable(uint32_t *tbl256, int endian) FAST_FUNC;
 uint32_t crc32_block_endian1(uint32_t val, const void *buf, unsigned len, uint32_t *crc_table) FAST_FUNC;
 uint32_t crc32_block_endian0(uint32_t val, const void *buf, unsigned len, uint32_t *crc_table) FAST_FUNC;
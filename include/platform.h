@@ -404,11 +404,13 @@ typedef unsigned smalluint;
 #define HAVE_XTABS 1
 #define HAVE_MNTENT_H 1
 #define HAVE_NET_ETHERNET_H 1
+#define HAVE_OPENAT 1 /* and fstatat, fdopendir */
 #define HAVE_SYS_STATFS_H 1
 
 #if defined(__UCLIBC__)
 # if UCLIBC_VERSION < KERNEL_VERSION(0, 9, 32)
 #  undef HAVE_STRVERSCMP
+#  undef HAVE_OPENAT
 # endif
 # if UCLIBC_VERSION >= KERNEL_VERSION(0, 9, 30)
 #  ifndef __UCLIBC_SUSV3_LEGACY__
@@ -419,6 +421,7 @@ typedef unsigned smalluint;
 
 #if ENABLE_PLATFORM_MINGW32
 # undef HAVE_DPRINTF
+# undef HAVE_OPENAT
 # undef HAVE_GETLINE
 # undef HAVE_MEMRCHR
 # undef HAVE_MKDTEMP
@@ -438,6 +441,7 @@ typedef unsigned smalluint;
 
 #if defined(__WATCOMC__)
 # undef HAVE_DPRINTF
+# undef HAVE_OPENAT
 # undef HAVE_GETLINE
 # undef HAVE_MEMRCHR
 # undef HAVE_MKDTEMP
@@ -483,6 +487,7 @@ typedef unsigned smalluint;
 
 #if defined(__dietlibc__)
 # undef HAVE_STRCHRNUL
+# undef HAVE_OPENAT
 #endif
 
 #if defined(__APPLE__)
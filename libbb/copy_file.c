@@ -8,6 +8,12 @@
  * Licensed under GPLv2 or later, see file LICENSE in this source tree.
  */
 #include "libbb.h"
+#if ENABLE_FEATURE_CP_REFLINK
+# include <sys/ioctl.h>
+# ifndef FICLONE
+#  define FICLONE _IOW(0x94, 9, int)
+# endif
+#endif
 
 // FEATURE_NON_POSIX_CP:
 //
@@ -20,6 +26,34 @@
 // This is strange, but POSIX-correct.
 // coreutils cp has --remove-destination to override this...
 
+/* Copy contents of source, already open as src_fd.
+ * Try to share data blocks if asked. Do not write the holes
+ * of sparse files, or any blocks of zeros if --sparse=always */
+static off_t copy_file_data(int src_fd, int dst_fd, const struct stat *source_stat,
+		const char *source, const char *dest, int flags)
+{
+#if ENABLE_FEATURE_CP_REFLINK
+	if (flags & FILEUTILS_REFLINK) {
+		if (ioctl(dst_fd, FICLONE, src_fd) == 0)
+			return source_stat->st_size;
+		if (flags & FILEUTILS_REFLINK_ALWAYS) {
+			bb_perror_msg("failed to clone '%s' from '%s'", dest, source);
+			return -1;
+		}
+	}
+#endif
+	if (flags & FILEUTILS_SPARSE_ALWAYS)
+		return bb_copyfd_sparse(src_fd, dst_fd, 0);
+	/* Fewer blocks than size needs: there are holes */
+	if (!(flags & FILEUTILS_SPARSE_NEVER)
+	 && S_ISREG(source_stat->st_mode)
+	 && (off_t)source_stat->st_blocks * 512 < source_stat->st_size
+	) {
+		return bb_copyfd_holes(src_fd, dst_fd, source_stat->st_size);
+	}
+	return bb_copyfd_eof(src_fd, dst_fd);
+}
+
 /* Called if open of destination, link creation etc fails.
  * errno must be set to relevant value ("why we cannot create dest?")
  * to give reasonable error message */
@@ -343,14 +377,14 @@ int FAST_FUNC copy_file(const char *source, const char *dest, int flags)
 			}
 		}
 #endif
-		if (bb_copyfd_eof(src_fd, dst_fd) == -1)
+		if (copy_file_data(src_fd, dst_fd, &source_stat, source, dest, flags) == -1)
 			retval = -1;
 		/* Careful with writing... */
 		if (close(dst_fd) < 0) {
 			bb_perror_msg("error writing to '%s'", dest);
 			retval = -1;
 		}
-		/* ...but read size is already checked by bb_copyfd_eof */
+		/* ...but read size is already checked by copy_file_data */
 		close(src_fd);
 		/* "cp /dev/something new_file" should not
 		 * copy mode of /dev/something */
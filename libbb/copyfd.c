@@ -13,6 +13,18 @@
 #else
 # define sendfile(a,b,c,d) (-1)
 #endif
+#if ENABLE_FEATURE_USE_COPY_FILE_RANGE
+# include <sys/syscall.h>
+#endif
+#if ENABLE_FEATURE_USE_COPY_FILE_RANGE && defined(__NR_copy_file_range)
+/* Not every libc has a wrapper */
+# define copy_file_range(in, out, len) \
+	syscall(__NR_copy_file_range, (in), NULL, (out), NULL, (size_t)(len), 0)
+#else
+# undef ENABLE_FEATURE_USE_COPY_FILE_RANGE
+# define ENABLE_FEATURE_USE_COPY_FILE_RANGE 0
+# define copy_file_range(in, out, len) (-1)
+#endif
 
 /*
  * We were using 0x7fff0000 as sendfile chunk size, but it
@@ -26,12 +38,15 @@
 /* Used by NOFORK applets (e.g. cat) - must not use xmalloc.
  * size < 0 means "ignore write errors", used by tar --to-command
  * size = 0 means "copy till EOF"
+ * sparse: seek over all-zero blocks instead of writing them
  */
-static off_t bb_full_fd_action(int src_fd, int dst_fd, off_t size)
+static off_t bb_full_fd_action(int src_fd, int dst_fd, off_t size, bool sparse)
 {
 	int status = -1;
 	off_t total = 0;
 	bool continue_on_write_error = 0;
+	bool in_kernel; /* data did not go through buffer */
+	bool try_copy_range;
 	ssize_t sendfile_sz;
 #if CONFIG_FEATURE_COPYBUF_KB > 4
 	char *buffer = buffer; /* for compiler */
@@ -49,7 +64,9 @@ static off_t bb_full_fd_action(int src_fd, int dst_fd, off_t size)
 	if (src_fd < 0)
 		goto out;
 
-	sendfile_sz = !ENABLE_FEATURE_USE_SENDFILE
+	/* dst_fd == -1 is a fake: read only */
+	try_copy_range = (ENABLE_FEATURE_USE_COPY_FILE_RANGE && dst_fd >= 0 && !sparse);
+	sendfile_sz = (!ENABLE_FEATURE_USE_SENDFILE || sparse)
 		? 0
 		: SENDFILE_BIGBUF;
 	if (!size) {
@@ -60,6 +77,17 @@ static off_t bb_full_fd_action(int src_fd, int dst_fd, off_t size)
 	while (1) {
 		ssize_t rd;
 
+		in_kernel = 1;
+		if (try_copy_range) {
+			rd = copy_file_range(src_fd, dst_fd,
+				size > SENDFILE_BIGBUF ? SENDFILE_BIGBUF : size);
+			if (rd > 0)
+				goto read_ok;
+			/* Not files, or other fs type (before Linux 5.3)...
+			 * Also, files in /proc etc claim to be empty to it:
+			 * let the others find out whether it is really EOF */
+			try_copy_range = 0;
+		}
 		if (sendfile_sz) {
 			rd = sendfile(dst_fd, src_fd, NULL,
 				size > sendfile_sz ? sendfile_sz : size);
@@ -67,6 +95,7 @@ static off_t bb_full_fd_action(int src_fd, int dst_fd, off_t size)
 				goto read_ok;
 			sendfile_sz = 0; /* do not try sendfile anymore */
 		}
+		in_kernel = 0;
 #if CONFIG_FEATURE_COPYBUF_KB > 4
 		if (buffer_size == 0) {
 			if (size > 0 && size <= 4 * 1024)
@@ -97,8 +126,10 @@ static off_t bb_full_fd_action(int src_fd, int dst_fd, off_t size)
 			break;
 		}
 		/* dst_fd == -1 is a fake, else... */
-		if (dst_fd >= 0 && !sendfile_sz) {
-			ssize_t wr = full_write(dst_fd, buffer, rd);
+		if (dst_fd >= 0 && !in_kernel) {
+			ssize_t wr = sparse
+				? full_write_sparse(dst_fd, buffer, rd)
+				: full_write(dst_fd, buffer, rd);
 			if (wr < rd) {
 				if (!continue_on_write_error) {
 					bb_perror_msg(bb_msg_write_error);
@@ -138,7 +169,7 @@ void FAST_FUNC complain_copyfd_and_die(off_t sz)
 off_t FAST_FUNC bb_copyfd_size(int fd1, int fd2, off_t size)
 {
 	if (size) {
-		return bb_full_fd_action(fd1, fd2, size);
+		return bb_full_fd_action(fd1, fd2, size, 0);
 	}
 	return 0;
 }
@@ -156,5 +187,81 @@ void FAST_FUNC bb_copyfd_exact_size(int fd1, int fd2, off_t size)
 
 off_t FAST_FUNC bb_copyfd_eof(int fd1, int fd2)
 {
-	return bb_full_fd_action(fd1, fd2, 0);
+	return bb_full_fd_action(fd1, fd2, 0, 0);
+}
+
+/* Like bb_copyfd_size(), but size = 0 means "copy till EOF",
+ * and blocks of zeros become holes in fd2 */
+off_t FAST_FUNC bb_copyfd_sparse(int fd1, int fd2, off_t size)
+{
+	struct stat st;
+	off_t sz;
+
+	/* Skipping blocks of a device would leave old data there */
+	if (fstat(fd2, &st) != 0 || !S_ISREG(st.st_mode))
+		return bb_full_fd_action(fd1, fd2, size, 0);
+	sz = bb_full_fd_action(fd1, fd2, size, 1);
+	if (sz >= 0 && full_write_sparse_end(fd2) != 0) {
+		bb_perror_msg(bb_msg_write_error);
+		return -1;
+	}
+	return sz;
+}
+
+/* fd1 must be a regular file at offset 0, fd2 an empty one.
+ * Only data is copied: we seek over holes and extend fd2
+ * to the full size at the end.
+ */
+off_t FAST_FUNC bb_copyfd_holes(int fd1, int fd2, off_t size)
+{
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	struct stat st;
+	off_t pos;
+
+	if (fstat(fd2, &st) != 0 || !S_ISREG(st.st_mode))
+		goto no_holes;
+	pos = 0;
+	while (pos < size) {
+		off_t data, hole, sz;
+
+		data = lseek(fd1, pos, SEEK_DATA);
+		if (data < 0) {
+			if (errno == ENXIO) { /* only a hole after pos */
+				pos = size;
+				break;
+			}
+			if (pos == 0) /* fs can't tell */
+				goto no_holes;
+			bb_perror_msg(bb_msg_read_error);
+			return -1;
+		}
+		if (data >= size) {
+			pos = size;
+			break;
+		}
+		hole = lseek(fd1, data, SEEK_HOLE);
+		if (hole < 0 || hole > size)
+			hole = size;
+		if (lseek(fd1, data, SEEK_SET) < 0
+		 || lseek(fd2, data, SEEK_SET) < 0
+		) {
+			bb_perror_msg("seek error");
+			return -1;
+		}
+		sz = bb_copyfd_size(fd1, fd2, hole - data);
+		if (sz < 0)
+			return sz;
+		pos = data + sz;
+		if (sz < hole - data) /* file shrank */
+			break;
+	}
+	/* Size is set even if file ends in a hole */
+	if (ftruncate(fd2, pos) != 0) {
+		bb_perror_msg(bb_msg_write_error);
+		return -1;
+	}
+	return pos;
+ no_holes:
+#endif
+	return bb_copyfd_size(fd1, fd2, size);
 }
@@ -18,6 +18,32 @@
 
 #include "libbb.h"
 
+#if CONFIG_CRC32_SMALL <= 0
+/* Allocated tables have 8 parts: [0] is the usual bytewise table,
+ * [k][i] is the CRC of byte i followed by k zero bytes.
+ * This lets us process 8 bytes at a time ("slicing-by-8").
+ * Tables given to us by callers are only 256 entries long:
+ * they are not usable with crc32_block_endianN().
+ */
+# define CRC32_SLICES 8
+#else
+# define CRC32_SLICES 1
+#endif
+
+/* On x86-64, CRC32 of larger blocks is computed by "folding" them
+ * with carry-less multiplication (see Intel's "Fast CRC Computation
+ * for Generic Polynomials Using PCLMULQDQ Instruction"). Whether CPU
+ * has the instruction is checked at run time.
+ * Only little-endian (bit-reflected) CRC32 is done this way.
+ */
+#if CONFIG_CRC32_SMALL <= 0 && defined(__x86_64__) && defined(__GNUC__)
+# define CRC32_PCLMUL 1
+# include <cpuid.h>
+# include <immintrin.h>
+#else
+# define CRC32_PCLMUL 0
+#endif
+
 uint32_t *global_crc32_table;
 
 uint32_t* FAST_FUNC crc32_filltable(uint32_t *crc_table, int endian)
@@ -25,9 +51,12 @@ uint32_t* FAST_FUNC crc32_filltable(uint32_t *crc_table, int endian)
 	uint32_t polynomial = endian ? 0x04c11db7 : 0xedb88320;
 	uint32_t c;
 	int i, j;
+	int slices = 1;
 
-	if (!crc_table)
-		crc_table = xmalloc(256 * sizeof(uint32_t));
+	if (!crc_table) {
+		slices = CRC32_SLICES;
+		crc_table = xmalloc(slices * 256 * sizeof(uint32_t));
+	}
 
 	for (i = 0; i < 256; i++) {
 		c = endian ? (i << 24) : i;
@@ -37,16 +66,41 @@ uint32_t* FAST_FUNC crc32_filltable(uint32_t *crc_table, int endian)
 			else
 				c = (c&1) ? ((c >> 1) ^ polynomial) : (c >> 1);
 		}
-		*crc_table++ = c;
+		crc_table[i] = c;
+	}
+	for (i = 256; i < slices * 256; i++) {
+		c = crc_table[i - 256];
+		if (endian)
+			crc_table[i] = (c << 8) ^ crc_table[c >> 24];
+		else
+			crc_table[i] = (c >> 8) ^ crc_table[(uint8_t)c];
 	}
 
-	return crc_table - 256;
+	return crc_table;
 }
 
 uint32_t FAST_FUNC crc32_block_endian1(uint32_t val, const void *buf, unsigned len, uint32_t *crc_table)
 {
 	const void *end = (uint8_t*)buf + len;
 
+#if CRC32_SLICES == 8
+	while (len >= 8) {
+		const uint8_t *p = buf;
+		uint32_t one = (((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]) ^ val;
+		uint32_t two =  ((uint32_t)p[4] << 24) | (p[5] << 16) | (p[6] << 8) | p[7];
+
+		val = crc_table[7*256 + (one >> 24)]
+		    ^ crc_table[6*256 + (uint8_t)(one >> 16)]
+		    ^ crc_table[5*256 + (uint8_t)(one >> 8)]
+		    ^ crc_table[4*256 + (uint8_t)one]
+		    ^ crc_table[3*256 + (two >> 24)]
+		    ^ crc_table[2*256 + (uint8_t)(two >> 16)]
+		    ^ crc_table[1*256 + (uint8_t)(two >> 8)]
+		    ^ crc_table[0*256 + (uint8_t)two];
+		buf = p + 8;
+		len -= 8;
+	}
+#endif
 	while (buf != end) {
 		val = (val << 8) ^ crc_table[(val >> 24) ^ *(uint8_t*)buf];
 		buf = (uint8_t*)buf + 1;
@@ -54,10 +108,139 @@ uint32_t FAST_FUNC crc32_block_endian1(uint32_t val, const void *buf, unsigned l
 	return val;
 }
 
+#if CRC32_PCLMUL
+/* Constants are for the bit-reflected 0xedb88320 polynomial */
+static const uint64_t k1k2[2] ALIGNED(16) = { 0x0154442bd4, 0x01c6e41596 };
+static const uint64_t k3k4[2] ALIGNED(16) = { 0x01751997d0, 0x00ccaa009e };
+static const uint64_t k5k0[2] ALIGNED(16) = { 0x0163cd6124, 0x0000000000 };
+static const uint64_t poly[2] ALIGNED(16) = { 0x01db710641, 0x01f7011641 };
+
+/* len >= 64, multiple of 16 */
+static uint32_t __attribute__((target("pclmul,sse4.1")))
+crc32_pclmul(uint32_t val, const uint8_t *buf, unsigned len)
+{
+	__m128i x0, x1, x2, x3, x4, x5;
+
+	x1 = _mm_loadu_si128((__m128i*)(buf + 0x00));
+	x2 = _mm_loadu_si128((__m128i*)(buf + 0x10));
+	x3 = _mm_loadu_si128((__m128i*)(buf + 0x20));
+	x4 = _mm_loadu_si128((__m128i*)(buf + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(val));
+	x0 = _mm_load_si128((__m128i*)k1k2);
+	buf += 64;
+	len -= 64;
+
+	/* Fold 4 x 128 bits at a time */
+	while (len >= 64) {
+		__m128i x6, x7, x8;
+
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((__m128i*)(buf + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((__m128i*)(buf + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((__m128i*)(buf + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((__m128i*)(buf + 0x30)));
+		buf += 64;
+		len -= 64;
+	}
+
+	/* Fold into 128 bits */
+	x0 = _mm_load_si128((__m128i*)k3k4);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	/* Remaining 16-byte blocks */
+	while (len >= 16) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((__m128i*)buf)), x5);
+		buf += 16;
+		len -= 16;
+	}
+
+	/* Fold 128 bits to 64 bits */
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+	x0 = _mm_loadl_epi64((__m128i*)k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* Barrett reduction to 32 bits */
+	x0 = _mm_load_si128((__m128i*)poly);
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return _mm_extract_epi32(x1, 1);
+}
+
+static int have_pclmul(void)
+{
+	/* 0: not checked yet, 1: yes, -1: no */
+	static int8_t have;
+
+	if (!have) {
+		unsigned eax, ebx, ecx, edx;
+
+		have = -1;
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)
+		 && (ecx & bit_PCLMUL) && (ecx & bit_SSE4_1)
+		) {
+			have = 1;
+		}
+	}
+	return have > 0;
+}
+#endif
+
 uint32_t FAST_FUNC crc32_block_endian0(uint32_t val, const void *buf, unsigned len, uint32_t *crc_table)
 {
 	const void *end = (uint8_t*)buf + len;
 
+#if CRC32_PCLMUL
+	if (len >= 64 && have_pclmul()) {
+		val = crc32_pclmul(val, buf, len & ~15);
+		buf = (uint8_t*)buf + (len & ~15);
+		len &= 15;
+	}
+#endif
+#if CRC32_SLICES == 8
+	while (len >= 8) {
+		const uint8_t *p = buf;
+		uint32_t one = (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24)) ^ val;
+		uint32_t two =  p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+
+		val = crc_table[7*256 + (uint8_t)one]
+		    ^ crc_table[6*256 + (uint8_t)(one >> 8)]
+		    ^ crc_table[5*256 + (uint8_t)(one >> 16)]
+		    ^ crc_table[4*256 + (one >> 24)]
+		    ^ crc_table[3*256 + (uint8_t)two]
+		    ^ crc_table[2*256 + (uint8_t)(two >> 8)]
+		    ^ crc_table[1*256 + (uint8_t)(two >> 16)]
+		    ^ crc_table[0*256 + (two >> 24)];
+		buf = p + 8;
+		len -= 8;
+	}
+#endif
 	while (buf != end) {
 		val = crc_table[(uint8_t)val ^ *(uint8_t*)buf] ^ (val >> 8);
 		buf = (uint8_t*)buf + 1;
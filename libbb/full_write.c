@@ -40,3 +40,90 @@ ssize_t FAST_FUNC full_write(int fd, const void *buf, size_t len)
 
 	return total;
 }
+
+/* True if all bytes of buf are zero. Compares a word at a time */
+int FAST_FUNC is_zero_block(const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	const unsigned long *w;
+
+	while (len && ((uintptr_t)p & (sizeof(long) - 1))) {
+		if (*p++)
+			return 0;
+		len--;
+	}
+	w = (const unsigned long *)p;
+	while (len >= 4 * sizeof(long)) {
+		if (w[0] | w[1] | w[2] | w[3])
+			return 0;
+		w += 4;
+		len -= 4 * sizeof(long);
+	}
+	p = (const unsigned char *)w;
+	while (len) {
+		if (*p++)
+			return 0;
+		len--;
+	}
+	return 1;
+}
+
+#define SPARSE_BLOCK 4096
+
+/*
+ * Like full_write, but all-zero SPARSE_BLOCK sized pieces of buf
+ * are skipped with lseek, leaving holes in a regular file.
+ * If fd can't seek, zeros are written.
+ */
+ssize_t FAST_FUNC full_write_sparse(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	size_t done = 0;
+
+	while (done < len) {
+		size_t start, n;
+		ssize_t cc;
+
+		n = len - done;
+		if (n > SPARSE_BLOCK)
+			n = SPARSE_BLOCK;
+		if (is_zero_block(p + done, n)
+		 && lseek(fd, n, SEEK_CUR) != (off_t)-1
+		) {
+			done += n;
+			continue;
+		}
+		/* Write this block and all non-zero ones after it at once */
+		start = done;
+		done += n;
+		while (done < len) {
+			n = len - done;
+			if (n > SPARSE_BLOCK)
+				n = SPARSE_BLOCK;
+			if (is_zero_block(p + done, n))
+				break;
+			done += n;
+		}
+		cc = full_write(fd, p + start, done - start);
+		if (cc != (ssize_t)(done - start)) {
+			if (cc < 0 && start == 0)
+				return cc;
+			return start + (cc > 0 ? cc : 0);
+		}
+	}
+	return done;
+}
+
+/* If we seeked past the end of fd, set its size */
+int FAST_FUNC full_write_sparse_end(int fd)
+{
+	struct stat st;
+	off_t pos;
+
+	pos = lseek(fd, 0, SEEK_CUR);
+	if (pos == (off_t)-1 || fstat(fd, &st) != 0)
+		return 0; /* not seekable: we did not skip anything */
+	if (S_ISREG(st.st_mode) && st.st_size < pos)
+		return ftruncate(fd, pos);
+	return 0;
+}
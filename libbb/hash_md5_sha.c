@@ -559,6 +559,94 @@ static void FAST_FUNC sha1_process_block64(sha1_ctx_t *ctx)
 	ctx->hash[4] += e;
 }
 
+#if (ENABLE_SHA1_HWACCEL || ENABLE_SHA256_HWACCEL) \
+ && defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+/* Intel SHA extensions. Availability is checked at run time
+ * by *_begin(), which then installs these block functions.
+ * State layout in ctx->hash[] is the same as for generic code.
+ */
+# define SHA_NI 1
+# include <cpuid.h>
+# include <immintrin.h>
+# define SHA_NI_FUNC __attribute__((target("sha,sse4.1")))
+
+static int have_shaNI(void)
+{
+	/* 0: not checked yet, 1: yes, -1: no */
+	static int8_t have;
+
+	if (!have) {
+		unsigned eax, ebx, ecx, edx;
+
+		have = -1;
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)
+		 && (ecx & bit_SSE4_1)
+		 && __get_cpuid_max(0, NULL) >= 7
+		) {
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			if (ebx & (1 << 29)) /* SHA */
+				have = 1;
+		}
+	}
+	return have > 0;
+}
+#else
+# define SHA_NI 0
+#endif
+
+#if ENABLE_SHA1_HWACCEL && SHA_NI
+static void FAST_FUNC SHA_NI_FUNC sha1_process_block64_shaNI(sha1_ctx_t *ctx)
+{
+	/* Byte-reverses the whole 16 bytes: big-endian words, lane 3 is W[t] */
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e, e_save, e_prev;
+	__m128i msg[4];
+	unsigned g;
+
+	abcd = _mm_loadu_si128((__m128i*)ctx->hash);
+	abcd = _mm_shuffle_epi32(abcd, 0x1B);
+	abcd_save = abcd;
+	e_save = _mm_set_epi32(ctx->hash[4], 0, 0, 0);
+
+	/* Each step is 4 rounds. First four steps use the block itself,
+	 * then message schedule is computed four words at a time */
+#define SHA1_STEP(f) \
+do { \
+	__m128i m; \
+	if (g < 4) { \
+		m = _mm_loadu_si128((__m128i*)(ctx->wbuffer + 16 * g)); \
+		m = _mm_shuffle_epi8(m, mask); \
+	} else { \
+		m = _mm_sha1msg1_epu32(msg[g & 3], msg[(g + 1) & 3]); \
+		m = _mm_xor_si128(m, msg[(g + 2) & 3]); \
+		m = _mm_sha1msg2_epu32(m, msg[(g + 3) & 3]); \
+	} \
+	msg[g & 3] = m; \
+	if (g == 0) \
+		e = _mm_add_epi32(e_save, m); \
+	else \
+		e = _mm_sha1nexte_epu32(e_prev, m); \
+	e_prev = abcd; \
+	abcd = _mm_sha1rnds4_epu32(abcd, e, f); \
+} while (0)
+	for (g = 0; g < 5; g++)
+		SHA1_STEP(0);
+	for (; g < 10; g++)
+		SHA1_STEP(1);
+	for (; g < 15; g++)
+		SHA1_STEP(2);
+	for (; g < 20; g++)
+		SHA1_STEP(3);
+#undef SHA1_STEP
+
+	e = _mm_sha1nexte_epu32(e_prev, e_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+	abcd = _mm_shuffle_epi32(abcd, 0x1B);
+	_mm_storeu_si128((__m128i*)ctx->hash, abcd);
+	ctx->hash[4] = _mm_extract_epi32(e, 3);
+}
+#endif
+
 /* Constants for SHA512 from FIPS 180-2:4.2.3.
  * SHA256 constants from FIPS 180-2:4.2.2
  * are the most significant half of first 64 elements
@@ -679,6 +767,59 @@ static void FAST_FUNC sha256_process_block64(sha256_ctx_t *ctx)
 	ctx->hash[7] += h;
 }
 
+#if ENABLE_SHA256_HWACCEL && SHA_NI
+static void FAST_FUNC SHA_NI_FUNC sha256_process_block64_shaNI(sha256_ctx_t *ctx)
+{
+	/* Byte-swaps each 32-bit word */
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i state0, state1, abef_save, cdgh_save, tmp;
+	__m128i msg[4];
+	unsigned g;
+
+	/* Instructions want state as ABEF and CDGH */
+	tmp = _mm_loadu_si128((__m128i*)&ctx->hash[0]);
+	state1 = _mm_loadu_si128((__m128i*)&ctx->hash[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);             /* CDAB */
+	state1 = _mm_shuffle_epi32(state1, 0x1B);       /* EFGH */
+	state0 = _mm_alignr_epi8(tmp, state1, 8);       /* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);    /* CDGH */
+	abef_save = state0;
+	cdgh_save = state1;
+
+	/* Each step is 4 rounds */
+	for (g = 0; g < 16; g++) {
+		__m128i m;
+
+		if (g < 4) {
+			m = _mm_loadu_si128((__m128i*)(ctx->wbuffer + 16 * g));
+			m = _mm_shuffle_epi8(m, mask);
+		} else {
+			/* W[t-16] + R0(W[t-15]) + W[t-7], then + R1(W[t-2]) */
+			m = _mm_sha256msg1_epu32(msg[g & 3], msg[(g + 1) & 3]);
+			m = _mm_add_epi32(m, _mm_alignr_epi8(msg[(g + 3) & 3], msg[(g + 2) & 3], 4));
+			m = _mm_sha256msg2_epu32(m, msg[(g + 3) & 3]);
+		}
+		msg[g & 3] = m;
+		m = _mm_add_epi32(m, _mm_set_epi32(
+				sha_K[4*g + 3] >> 32, sha_K[4*g + 2] >> 32,
+				sha_K[4*g + 1] >> 32, sha_K[4*g + 0] >> 32
+		));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+		m = _mm_shuffle_epi32(m, 0x0E);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, m);
+	}
+
+	state0 = _mm_add_epi32(state0, abef_save);
+	state1 = _mm_add_epi32(state1, cdgh_save);
+	tmp = _mm_shuffle_epi32(state0, 0x1B);          /* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xB1);       /* DCHG */
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);    /* DCBA */
+	state1 = _mm_alignr_epi8(state1, tmp, 8);       /* ABEF */
+	_mm_storeu_si128((__m128i*)&ctx->hash[0], state0);
+	_mm_storeu_si128((__m128i*)&ctx->hash[4], state1);
+}
+#endif
+
 static void FAST_FUNC sha512_process_block128(sha512_ctx_t *ctx)
 {
 	unsigned t;
@@ -751,6 +892,10 @@ void FAST_FUNC sha1_begin(sha1_ctx_t *ctx)
 	ctx->hash[4] = 0xc3d2e1f0;
 	ctx->total64 = 0;
 	ctx->process_block = sha1_process_block64;
+#if ENABLE_SHA1_HWACCEL && SHA_NI
+	if (have_shaNI())
+		ctx->process_block = sha1_process_block64_shaNI;
+#endif
 }
 
 static const uint32_t init256[] = {
@@ -785,6 +930,10 @@ void FAST_FUNC sha256_begin(sha256_ctx_t *ctx)
 	memcpy(&ctx->total64, init256, sizeof(init256));
 	/*ctx->total64 = 0; - done by prepending two 32-bit zeros to init256 */
 	ctx->process_block = sha256_process_block64;
+#if ENABLE_SHA256_HWACCEL && SHA_NI
+	if (have_shaNI())
+		ctx->process_block = sha256_process_block64_shaNI;
+#endif
 }
 
 /* Initialize structure containing state of computation.
@@ -854,7 +1003,14 @@ void FAST_FUNC sha1_end(sha1_ctx_t *ctx, void *resbuf)
 	/* SHA stores total in BE, need to swap on LE arches: */
 	common64_end(ctx, /*swap_needed:*/ BB_LITTLE_ENDIAN);
 
-	hash_size = (ctx->process_block == sha1_process_block64) ? 5 : 8;
+	hash_size = 8;
+	if (ctx->process_block == sha1_process_block64
+#if ENABLE_SHA1_HWACCEL && SHA_NI
+	 || ctx->process_block == sha1_process_block64_shaNI
+#endif
+	) {
+		hash_size = 5;
+	}
 	/* This way we do not impose alignment constraints on resbuf: */
 	if (BB_LITTLE_ENDIAN) {
 		unsigned i;
@@ -10,96 +10,170 @@
 
 #include "libbb.h"
 
-typedef struct ino_dev_hash_bucket_struct {
+/* Open addressing with linear probing: a lookup is one multiply
+ * and (usually) one cache line, and there is no malloc per entry.
+ * The table doubles when it is 3/4 full, so it is fine with
+ * the millions of inodes du or cp -a can see.
+ */
+struct ino_dev_entry {
 	ino_t ino;
 	dev_t dev;
-	/*
-	 * Above fields can be 64-bit, while pointer may be 32-bit.
-	 * Putting "next" field here may reduce size of this struct:
-	 */
-	struct ino_dev_hash_bucket_struct *next;
+	void *data; /* NULL: free slot */
 	/*
 	 * Reportedly, on cramfs a file and a dir can have same ino.
 	 * Need to also remember "file/dir" bit:
 	 */
 	char isdir; /* bool */
-	char name[1];
-} ino_dev_hashtable_bucket_t;
+};
 
-#define HASH_SIZE      311u   /* Should be prime */
-#define hash_inode(i)  ((unsigned)(i) % HASH_SIZE)
+struct ino_dev_table {
+	unsigned mask;  /* size - 1, size is a power of 2 */
+	unsigned count;
+	struct ino_dev_entry e[1];
+};
 
-/* array of [HASH_SIZE] elements */
-static ino_dev_hashtable_bucket_t **ino_dev_hashtable;
+#define INITIAL_SIZE 64
 
-/*
- * Return name if statbuf->st_ino && statbuf->st_dev are recorded in
- * ino_dev_hashtable, else return NULL
- */
-char* FAST_FUNC is_in_ino_dev_hashtable(const struct stat *statbuf)
+static unsigned hash_ino_dev(ino_t ino, dev_t dev)
 {
-	ino_dev_hashtable_bucket_t *bucket;
+	/* Inode numbers are often sequential, and the same inode
+	 * number is common across devices: mix both, and take the top
+	 * bits of a multiplicative hash */
+	uint64_t h = ((uint64_t)ino ^ ((uint64_t)dev * 0x9e3779b97f4a7c15ULL))
+			* 0x9e3779b97f4a7c15ULL;
+	return (unsigned)(h >> 32);
+}
 
-	if (!ino_dev_hashtable)
-		return NULL;
+static struct ino_dev_entry *find_entry(ino_dev_table_t *t, const struct stat *statbuf)
+{
+	char isdir = !!S_ISDIR(statbuf->st_mode);
+	unsigned i = hash_ino_dev(statbuf->st_ino, statbuf->st_dev);
 
-	bucket = ino_dev_hashtable[hash_inode(statbuf->st_ino)];
-	while (bucket != NULL) {
-		if ((bucket->ino == statbuf->st_ino)
-		 && (bucket->dev == statbuf->st_dev)
-		 && (bucket->isdir == !!S_ISDIR(statbuf->st_mode))
+	while (1) {
+		struct ino_dev_entry *e = &t->e[i & t->mask];
+		if (!e->data
+		 || (e->ino == statbuf->st_ino
+		    && e->dev == statbuf->st_dev
+		    && e->isdir == isdir)
 		) {
-			return bucket->name;
+			return e;
 		}
-		bucket = bucket->next;
+		i++;
 	}
-	return NULL;
+}
+
+static ino_dev_table_t *alloc_table(unsigned size)
+{
+	ino_dev_table_t *t;
+
+	t = xzalloc(sizeof(*t) + (size - 1) * sizeof(t->e[0]));
+	t->mask = size - 1;
+	return t;
+}
+
+/* Return data stored for statbuf's dev/ino, or NULL */
+void* FAST_FUNC ino_dev_table_find(ino_dev_table_t *t, const struct stat *statbuf)
+{
+	if (!t)
+		return NULL;
+	return find_entry(t, statbuf)->data;
+}
+
+/* Return pointer to data stored for statbuf's dev/ino. If it was not
+ * there, an entry is added, data is NULL and caller must set it
+ * to something else before next call.
+ */
+void** FAST_FUNC ino_dev_table_add(ino_dev_table_t **tp, const struct stat *statbuf)
+{
+	ino_dev_table_t *t = *tp;
+	struct ino_dev_entry *e;
+
+	if (!t)
+		*tp = t = alloc_table(INITIAL_SIZE);
+	e = find_entry(t, statbuf);
+	if (e->data)
+		return &e->data;
+
+	if ((t->count + 1) * 4 > (t->mask + 1) * 3) {
+		ino_dev_table_t *n = alloc_table((t->mask + 1) * 2);
+		unsigned i;
+
+		for (i = 0; i <= t->mask; i++) {
+			struct ino_dev_entry *o = &t->e[i];
+			unsigned j;
+
+			if (!o->data)
+				continue;
+			j = hash_ino_dev(o->ino, o->dev);
+			while (n->e[j & n->mask].data)
+				j++;
+			n->e[j & n->mask] = *o;
+		}
+		n->count = t->count;
+		free(t);
+		*tp = t = n;
+		e = find_entry(t, statbuf);
+	}
+	t->count++;
+	e->ino = statbuf->st_ino;
+	e->dev = statbuf->st_dev;
+	e->isdir = !!S_ISDIR(statbuf->st_mode);
+	return &e->data;
+}
+
+void FAST_FUNC ino_dev_table_free(ino_dev_table_t *t, void FAST_FUNC (*free_data)(void *data))
+{
+	unsigned i;
+
+	if (!t)
+		return;
+	if (free_data) {
+		for (i = 0; i <= t->mask; i++)
+			if (t->e[i].data)
+				free_data(t->e[i].data);
+	}
+	free(t);
+}
+
+
+/* The table shared by du and cp -a. Names are malloced,
+ * except "" which is used for NULL and empty names */
+static ino_dev_table_t *ino_dev_hashtable;
+static const char no_name[] ALIGN1 = "";
+
+/*
+ * Return name if statbuf->st_ino && statbuf->st_dev are recorded in
+ * ino_dev_hashtable, else return NULL
+ */
+char* FAST_FUNC is_in_ino_dev_hashtable(const struct stat *statbuf)
+{
+	return ino_dev_table_find(ino_dev_hashtable, statbuf);
 }
 
 /* Add statbuf to statbuf hash table */
 void FAST_FUNC add_to_ino_dev_hashtable(const struct stat *statbuf, const char *name)
 {
 #if !ENABLE_PLATFORM_MINGW32
-	int i;
-	ino_dev_hashtable_bucket_t *bucket;
-
-	if (!name)
-		name = "";
-	bucket = xmalloc(sizeof(ino_dev_hashtable_bucket_t) + strlen(name));
-	bucket->ino = statbuf->st_ino;
-	bucket->dev = statbuf->st_dev;
-	bucket->isdir = !!S_ISDIR(statbuf->st_mode);
-	strcpy(bucket->name, name);
-
-	if (!ino_dev_hashtable)
-		ino_dev_hashtable = xzalloc(HASH_SIZE * sizeof(*ino_dev_hashtable));
-
-	i = hash_inode(statbuf->st_ino);
-	bucket->next = ino_dev_hashtable[i];
-	ino_dev_hashtable[i] = bucket;
+	void **data;
+
+	data = ino_dev_table_add(&ino_dev_hashtable, statbuf);
+	if (*data && *data != no_name)
+		free(*data);
+	*data = (name && name[0]) ? xstrdup(name) : (char*)no_name;
 #endif
 }
 
 #if ENABLE_DU || ENABLE_FEATURE_CLEAN_UP
+static void FAST_FUNC free_name(void *name)
+{
+	if (name != no_name)
+		free(name);
+}
+
 /* Clear statbuf hash table */
 void FAST_FUNC reset_ino_dev_hashtable(void)
 {
-	int i;
-	ino_dev_hashtable_bucket_t *bucket, *next;
-
-	if (!ino_dev_hashtable)
-		return;
-
-	for (i = 0; i < HASH_SIZE; i++) {
-		bucket = ino_dev_hashtable[i];
-
-		while (bucket != NULL) {
-			next = bucket->next;
-			free(bucket);
-			bucket = next;
-		}
-	}
-	free(ino_dev_hashtable);
+	ino_dev_table_free(ino_dev_hashtable, free_name);
 	ino_dev_hashtable = NULL;
 }
 #endif
@@ -22,6 +22,65 @@
  * is so stinking huge.
  */
 
+void FAST_FUNC dir_walk_init(dir_walk_t *w, const char *path)
+{
+	w->len = strlen(path);
+	w->size = w->len + 256;
+	w->path = xmalloc(w->size);
+	strcpy(w->path, path);
+}
+
+/* Same result as concat_path_file() */
+unsigned FAST_FUNC dir_walk_push(dir_walk_t *w, const char *name)
+{
+	unsigned old_len = w->len;
+	unsigned len = old_len;
+	unsigned nlen;
+
+	while (*name == '/')
+		name++;
+	nlen = strlen(name);
+	if (w->size < len + nlen + 2) {
+		w->size = (len + nlen + 2) * 2;
+		w->path = xrealloc(w->path, w->size);
+	}
+	if (len == 0 || w->path[len - 1] != '/')
+		w->path[len++] = '/';
+	memcpy(w->path + len, name, nlen + 1);
+	w->len = len + nlen;
+	return old_len;
+}
+
+int FAST_FUNC dir_walk_stat(dir_walk_t *w UNUSED_PARAM, int dir_fd UNUSED_PARAM,
+		const char *name UNUSED_PARAM, struct stat *st, int follow)
+{
+#ifdef HAVE_OPENAT
+	return fstatat(dir_fd, name, st, follow ? 0 : AT_SYMLINK_NOFOLLOW);
+#else
+	return (follow ? stat : lstat)(w->path, st);
+#endif
+}
+
+DIR* FAST_FUNC dir_walk_opendir(dir_walk_t *w UNUSED_PARAM, int dir_fd UNUSED_PARAM,
+		const char *name UNUSED_PARAM, int follow UNUSED_PARAM)
+{
+#ifdef HAVE_OPENAT
+	DIR *dir;
+	int fd;
+
+	fd = openat(dir_fd, name, O_RDONLY | O_NOCTTY | O_DIRECTORY | O_CLOEXEC
+			| (follow ? 0 : O_NOFOLLOW));
+	if (fd < 0)
+		return NULL;
+	dir = fdopendir(fd);
+	if (!dir)
+		close(fd);
+	return dir;
+#else
+	return opendir(w->path);
+#endif
+}
+
 static int FAST_FUNC true_action(const char *fileName UNUSED_PARAM,
 		struct stat *statbuf UNUSED_PARAM,
 		void* userData UNUSED_PARAM,
@@ -51,10 +110,17 @@ static int FAST_FUNC true_action(const char *fileName UNUSED_PARAM,
  * ACTION_FOLLOWLINKS mainly controls handling of links to dirs.
  * 0: lstat(statbuf). Calls fileAction on link name even if points to dir.
  * 1: stat(statbuf). Calls dirAction and optionally recurse on link to dir.
+ *
+ * ACTION_LAZY_STAT: don't stat entries if readdir tells their type,
+ * except links we may need to follow. Actions get a statbuf with
+ * only the file type and st_nlink == 0, they can stat fileName
+ * themselves if they need more.
+ *
+ * fileName passed to actions is only valid until they return.
  */
 
-int FAST_FUNC recursive_action(const char *fileName,
-		unsigned flags,
+static int recurse(dir_walk_t *w, int dir_fd, const char *name,
+		unsigned type, unsigned flags,
 		int FAST_FUNC (*fileAction)(const char *fileName, struct stat *statbuf, void* userData, int depth),
 		int FAST_FUNC (*dirAction)(const char *fileName, struct stat *statbuf, void* userData, int depth),
 		void* userData,
@@ -65,22 +131,26 @@ int FAST_FUNC recursive_action(const char *fileName,
 	int status;
 	DIR *dir;
 	struct dirent *next;
-
-	if (!fileAction) fileAction = true_action;
-	if (!dirAction) dirAction = true_action;
+#define fileName (w->path)
 
 	follow = ACTION_FOLLOWLINKS;
 	if (depth == 0)
 		follow = ACTION_FOLLOWLINKS | ACTION_FOLLOWLINKS_L0;
 	follow &= flags;
-	status = (follow ? stat : lstat)(fileName, &statbuf);
-	if (status < 0) {
+	if ((flags & ACTION_LAZY_STAT)
+	 && type != DT_UNKNOWN
+	 && !(type == DT_LNK && follow)
+	) {
+		memset(&statbuf, 0, sizeof(statbuf));
+		statbuf.st_mode = DTTOIF(type);
+	} else
+	if (dir_walk_stat(w, dir_fd, name, &statbuf, follow) < 0) {
 #ifdef DEBUG_RECURS_ACTION
-		bb_error_msg("status=%d flags=%x", status, flags);
+		bb_error_msg("errno=%d flags=%x", errno, flags);
 #endif
 		if ((flags & ACTION_DANGLING_OK)
 		 && errno == ENOENT
-		 && lstat(fileName, &statbuf) == 0
+		 && dir_walk_stat(w, dir_fd, name, &statbuf, 0) == 0
 		) {
 			/* Dangling link */
 			return fileAction(fileName, &statbuf, userData, depth);
@@ -111,7 +181,7 @@ int FAST_FUNC recursive_action(const char *fileName,
 			return TRUE;
 	}
 
-	dir = opendir(fileName);
+	dir = dir_walk_opendir(w, dir_fd, name, follow);
 	if (!dir) {
 		/* findutils-4.1.20 reports this */
 		/* (i.e. it doesn't silently return with exit code 1) */
@@ -120,25 +190,17 @@ int FAST_FUNC recursive_action(const char *fileName,
 	}
 	status = TRUE;
 	while ((next = readdir(dir)) != NULL) {
-		char *nextFile;
+		unsigned len;
 
-		nextFile = concat_subpath_file(fileName, next->d_name);
-		if (nextFile == NULL)
+		if (DOT_OR_DOTDOT(next->d_name))
 			continue;
+		len = dir_walk_push(w, next->d_name);
 		/* process every file (NB: ACTION_RECURSE is set in flags) */
-		if (!recursive_action(nextFile, flags, fileAction, dirAction,
-						userData, depth + 1))
+		if (!recurse(w, dir_walk_fd(dir), next->d_name,
+				dirent_type(next), flags,
+				fileAction, dirAction, userData, depth + 1))
 			status = FALSE;
-//		s = recursive_action(nextFile, flags, fileAction, dirAction,
-//						userData, depth + 1);
-		free(nextFile);
-//#define RECURSE_RESULT_ABORT 3
-//		if (s == RECURSE_RESULT_ABORT) {
-//			closedir(dir);
-//			return s;
-//		}
-//		if (s == FALSE)
-//			status = FALSE;
+		dir_walk_pop(w, len);
 	}
 	closedir(dir);
 
@@ -153,4 +215,25 @@ int FAST_FUNC recursive_action(const char *fileName,
 	if (!(flags & ACTION_QUIET))
 		bb_simple_perror_msg(fileName);
 	return FALSE;
+#undef fileName
+}
+
+int FAST_FUNC recursive_action(const char *fileName,
+		unsigned flags,
+		int FAST_FUNC (*fileAction)(const char *fileName, struct stat *statbuf, void* userData, int depth),
+		int FAST_FUNC (*dirAction)(const char *fileName, struct stat *statbuf, void* userData, int depth),
+		void* userData,
+		unsigned depth)
+{
+	dir_walk_t w;
+	int status;
+
+	if (!fileAction) fileAction = true_action;
+	if (!dirAction) dirAction = true_action;
+
+	dir_walk_init(&w, fileName);
+	status = recurse(&w, AT_FDCWD, fileName, DT_UNKNOWN, flags,
+			fileAction, dirAction, userData, depth);
+	free(w.path);
+	return status;
 }